@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdio.h>
+
+#define LAMMPSDAT_DEFAULT_BUFFER_SIZE (1 << 20)   ///< Default size of the output buffer (1 MiB)
+
 /**
  * @struct LammpsDat
  * @brief Descriptor for a LAMMPS-compatible data or trajectory file.
@@ -11,11 +16,13 @@
  * This struct stores the information needed to write particle coordinates
  * to a LAMMPS-style data file. It keeps track of the filename, the number
  * of frames written, the number of particles, and the cubic box length.
+ * The file stays open between frames, behind an output buffer of user chosen size.
  *
  * Usage:
- * 1. Initialize with `initLammpsData`.
+ * 1. Initialize with `initLammpsData` or `initLammpsDataBuffered`.
  * 2. Write frames with `writeLammpsDatFrame`.
- * 3. Free resources with `freeLammpsData`.
+ * 3. Optionally push buffered frames to disk with `flushLammpsData`.
+ * 4. Close the file and free resources with `freeLammpsData`.
  */
 typedef struct LAMMPS_DAT_FILE {
     char *filename;
@@ -24,6 +31,10 @@ typedef struct LAMMPS_DAT_FILE {
     size_t n_particles;
     double boxL;
 
+    FILE *fp;               ///< Open handle, NULL once closed
+    char *io_buffer;        ///< stdio buffer of `fp`
+    char *frame_buffer;     ///< Text of the frame being formatted
+    size_t frame_capacity;  ///< Size of `frame_buffer`
 } LammpsDat;
 
 /**
@@ -39,12 +50,39 @@ typedef struct LAMMPS_DAT_FILE {
  */
 void initLammpsData(LammpsDat *ld, const char *filename, size_t n_particles, double boxL);
 
+/**
+ * @brief Initialize a LAMMPS data file descriptor with an output buffer of `buffer_size` bytes.
+ *
+ * The file is created (truncated) immediately and kept open until `closeLammpsData`
+ * or `freeLammpsData`.
+ *
+ * @param ld Pointer to the LammpsDat struct to initialize.
+ * @param filename Name of the LAMMPS data file to create.
+ * @param n_particles Number of particles that will be stored in the file.
+ * @param boxL Length of the cubic box (assumes box from -boxL/2 to +boxL/2 in each dimension).
+ * @param buffer_size Size of the output buffer in bytes.
+ * @return 0 on success, -1 on failure
+ */
+int initLammpsDataBuffered(LammpsDat *ld, const char *filename, size_t n_particles, double boxL, size_t buffer_size);
+
+/**
+ * @brief Push the buffered frames to the operating system.
+ * @return 0 on success, -1 on failure
+ */
+int flushLammpsData(LammpsDat *ld);
+
+/**
+ * @brief Flush and close the file. Further frames are not written.
+ * @return 0 on success, -1 on failure
+ */
+int closeLammpsData(LammpsDat *ld);
+
 
 /**
  * @brief Free resources associated with a LammpsDat struct.
  *
- * Frees the memory allocated for the filename and resets the fields
- * of the struct. Should be called when the LammpsDat struct is no longer needed.
+ * Closes the file if still open, frees the memory allocated for the filename and buffers,
+ * and resets the fields of the struct. Should be called when the LammpsDat struct is no longer needed.
  *
  * @param ld Pointer to the LammpsDat struct to clean up.
  */
@@ -54,7 +92,8 @@ void freeLammpsData(LammpsDat *ld);
 /**
  * @brief Write a frame of particle coordinates to a LAMMPS-compatible file.
  *
- * The function appends a frame to the file. If it is the first frame, the file is created.
+ * The function appends a frame to the file. The whole frame is formatted in memory and
+ * handed to the output buffer with a single write.
  * Coordinates are expected as a flat array [x0,y0,z0, x1,y1,z1, ...]. The output format
  * uses LAMMPS "dump" style with TIMESTEP, NUMBER OF ATOMS, BOX BOUNDS, and ATOMS sections.
  *
@@ -10,57 +10,88 @@
 #include <string.h>
 
 #include "../include/gg_io.h"
+#include "lammps/lammpstrjIO/numformat.h"
 
-void initLammpsData(LammpsDat *ld, const char *filename, size_t n_particles, double boxL) {
-    if (!ld || !filename) return;
+// Longest atom line: three integers and three `%f` values, the latter up to FORMAT_FIXED6_MAX
+#define LAMMPSDAT_MAX_LINE 1100
+#define LAMMPSDAT_MAX_HEADER 512
+
+int initLammpsDataBuffered(LammpsDat *ld, const char *filename, size_t n_particles, double boxL, size_t buffer_size) {
+    if (!ld || !filename) return -1;
+
+    memset(ld, 0, sizeof(*ld));
 
     // Allocate memory for the filename string (+1 for null terminator)
     ld->filename = malloc(strlen(filename) + 1);
     if (!ld->filename) {
         fprintf(stderr, "Failed to allocate memory for filename: %s", filename);
-        return;
+        return -1;
     }
     strcpy(ld->filename, filename);
     ld->n_frames = 0;
     ld->n_particles = n_particles;
     ld->boxL = boxL;
-}
-
-
-void writeLammpsDatFrame(LammpsDat *ld, float *coordinates) {
-    if (!ld || !coordinates) return;
 
-    FILE *fp;
-    if (ld->n_frames == 0) {
-        // First frame: create file
-        fp = fopen(ld->filename, "w");
-        if (!fp) {
-            perror("Failed to open file for writing");
-            return;
-        }
-    } else {
-        // Append mode for subsequent frames
-        fp = fopen(ld->filename, "a");
-        if (!fp) {
-            perror("Failed to open file for appending");
-            return;
+    ld->fp = fopen(ld->filename, "w");
+    if (!ld->fp) {
+        perror("Failed to open file for writing");
+        freeLammpsData(ld);
+        return -1;
+    }
+    if (buffer_size > 0) {
+        ld->io_buffer = malloc(buffer_size);
+        if (ld->io_buffer) {
+            setvbuf(ld->fp, ld->io_buffer, _IOFBF, buffer_size);
         }
     }
 
-    fprintf(fp, "ITEM: TIMESTEP\n");
-    fprintf(fp,"%zu\n", ld->n_frames);
+    // Typical frame: short integers and coordinates below 1e6
+    ld->frame_capacity = LAMMPSDAT_MAX_HEADER + n_particles * 64 + LAMMPSDAT_MAX_LINE;
+    ld->frame_buffer = malloc(ld->frame_capacity);
+    if (!ld->frame_buffer) {
+        fprintf(stderr, "Failed to allocate memory for the frame buffer\n");
+        freeLammpsData(ld);
+        return -1;
+    }
+    return 0;
+}
+
+void initLammpsData(LammpsDat *ld, const char *filename, size_t n_particles, double boxL) {
+    initLammpsDataBuffered(ld, filename, n_particles, boxL, LAMMPSDAT_DEFAULT_BUFFER_SIZE);
+}
 
-    fprintf(fp, "ITEM: NUMBER OF ATOMS\n");
-    fprintf(fp, "%zu\n", ld->n_particles);
 
-    fprintf(fp, "ITEM: BOX BOUNDS pp pp pp\n");
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
+void writeLammpsDatFrame(LammpsDat *ld, float *coordinates) {
+    if (!ld || !coordinates) return;
+    if (!ld->fp) {
+        fprintf(stderr, "Failed to write frame: %s is closed\n", ld->filename ? ld->filename : "data file");
+        return;
+    }
 
-    fprintf(fp, "ITEM: ATOMS id mol type xu yu zu\n");
+    char *o = ld->frame_buffer;
+    o += sprintf(o, "ITEM: TIMESTEP\n%zu\n", ld->n_frames);
+    o += sprintf(o, "ITEM: NUMBER OF ATOMS\n%zu\n", ld->n_particles);
+    o += sprintf(o, "ITEM: BOX BOUNDS pp pp pp\n");
+    for (int d = 0; d < 3; d++) {
+        o += sprintf(o, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
+    }
+    o += sprintf(o, "ITEM: ATOMS id mol type xu yu zu\n");
 
     for (size_t i = 0; i < ld->n_particles; ++i) {
+        // Grow the buffer if a line with huge values might not fit
+        size_t used = (size_t) (o - ld->frame_buffer);
+        if (ld->frame_capacity - used < LAMMPSDAT_MAX_LINE) {
+            const size_t capacity = 2 * ld->frame_capacity;
+            char *buffer = realloc(ld->frame_buffer, capacity);
+            if (!buffer) {
+                fprintf(stderr, "Failed to allocate memory for the frame buffer\n");
+                return;
+            }
+            ld->frame_buffer = buffer;
+            ld->frame_capacity = capacity;
+            o = buffer + used;
+        }
+
         size_t id = i+1;
         size_t molId = 1;
         size_t type = 1;
@@ -69,21 +100,57 @@ void writeLammpsDatFrame(LammpsDat *ld, float *coordinates) {
         double yu = coordinates[3*i+1];
         double zu = coordinates[3*i+2];
 
-        fprintf(fp, "%zu %zu %zu %f %f %f\n", id, molId, type, xu, yu, zu);
+        // Same text as "%zu %zu %zu %f %f %f\n"
+        o = formatUnsigned(o, id);    *o++ = ' ';
+        o = formatUnsigned(o, molId); *o++ = ' ';
+        o = formatUnsigned(o, type);  *o++ = ' ';
+        o = formatFixed6(o, xu);      *o++ = ' ';
+        o = formatFixed6(o, yu);      *o++ = ' ';
+        o = formatFixed6(o, zu);      *o++ = '\n';
     }
 
-    fclose(fp);
+    const size_t len = (size_t) (o - ld->frame_buffer);
+    if (fwrite(ld->frame_buffer, 1, len, ld->fp) != len) {
+        perror("Failed to write frame");
+        return;
+    }
     ld->n_frames += 1;
 }
 
 
+int flushLammpsData(LammpsDat *ld) {
+    if (!ld || !ld->fp) return -1;
+    return fflush(ld->fp) == 0 ? 0 : -1;
+}
+
+
+int closeLammpsData(LammpsDat *ld) {
+    if (!ld || !ld->fp) return -1;
+    const int status = fclose(ld->fp) == 0 ? 0 : -1;
+    ld->fp = NULL;
+    free(ld->io_buffer);
+    ld->io_buffer = NULL;
+    if (status != 0) {
+        perror("Failed to close data file");
+    }
+    return status;
+}
+
+
 void freeLammpsData(LammpsDat *ld) {
     if (!ld) return;
 
+    if (ld->fp) {
+        closeLammpsData(ld);
+    }
+
     if (ld->filename) {
         free(ld->filename);
         ld->filename = NULL;
     }
+    free(ld->frame_buffer);
+    ld->frame_buffer = NULL;
+    ld->frame_capacity = 0;
 
     ld->n_frames = 0;
     ld->n_particles = 0;
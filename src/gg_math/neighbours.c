@@ -0,0 +1,256 @@
+// neighbours.c
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neighbours.h"
+
+// Half of the 26 neighbouring cells: every pair of cells is visited once
+static const int HALF_STENCIL[13][3] = {
+    { 1,  0, 0}, {-1,  1, 0}, { 0,  1, 0}, { 1,  1, 0},
+    {-1, -1, 1}, { 0, -1, 1}, { 1, -1, 1},
+    {-1,  0, 1}, { 0,  0, 1}, { 1,  0, 1},
+    {-1,  1, 1}, { 0,  1, 1}, { 1,  1, 1}
+};
+
+// Minimum image of r_j - r_i
+static inline double minimumImage(const CellList* cl, const double* coordinates, size_t i, size_t j,
+                                  double* dx, double* dy, double* dz) {
+    *dx = coordinates[3*j]   - coordinates[3*i];
+    *dy = coordinates[3*j+1] - coordinates[3*i+1];
+    *dz = coordinates[3*j+2] - coordinates[3*i+2];
+    *dx -= cl->L[0] * nearbyint(*dx * cl->inv_L[0]);
+    *dy -= cl->L[1] * nearbyint(*dy * cl->inv_L[1]);
+    *dz -= cl->L[2] * nearbyint(*dz * cl->inv_L[2]);
+    return (*dx)*(*dx) + (*dy)*(*dy) + (*dz)*(*dz);
+}
+
+static inline size_t cellIndex(const CellList* cl, size_t cx, size_t cy, size_t cz) {
+    return (cz * cl->n_cells[1] + cy) * cl->n_cells[0] + cx;
+}
+
+int initCellList(CellList* cl, const double* box_lengths, double cutoff, size_t n_particles) {
+    memset(cl, 0, sizeof(CellList));
+    for (int d = 0; d < 3; d++) {
+        if (!(cutoff > 0.) || !(2. * cutoff <= box_lengths[d])) {
+            fprintf(stderr, "Error: The cutoff %lf must be positive and at most half the box side %lf.\n",
+                    cutoff, box_lengths[d]);
+            return -1;
+        }
+        cl->L[d] = box_lengths[d];
+        cl->inv_L[d] = 1. / box_lengths[d];
+        cl->n_cells[d] = (size_t) (box_lengths[d] / cutoff);
+    }
+    // With fewer than 3 cells along a side the stencil would visit a cell twice: use a single cell
+    if (cl->n_cells[0] < 3 || cl->n_cells[1] < 3 || cl->n_cells[2] < 3) {
+        cl->n_cells[0] = cl->n_cells[1] = cl->n_cells[2] = 1;
+    }
+    cl->cutoff = cutoff;
+    cl->n_particles = n_particles;
+
+    const size_t total_cells = cl->n_cells[0] * cl->n_cells[1] * cl->n_cells[2];
+    cl->start = calloc(total_cells + 1, sizeof(size_t));
+    cl->order = malloc((n_particles > 0 ? n_particles : 1) * sizeof(size_t));
+    cl->cell = malloc((n_particles > 0 ? n_particles : 1) * sizeof(size_t));
+    cl->sorted = malloc((n_particles > 0 ? 3 * n_particles : 1) * sizeof(double));
+    if (!cl->start || !cl->order || !cl->cell || !cl->sorted) {
+        fprintf(stderr, "Error: Memory allocation failed for a cell list of %zu cells.\n", total_cells);
+        freeCellList(cl);
+        return -1;
+    }
+    return 0;
+}
+
+void buildCellList(CellList* cl, const double* coordinates) {
+    const size_t total_cells = cl->n_cells[0] * cl->n_cells[1] * cl->n_cells[2];
+    memset(cl->start, 0, (total_cells + 1) * sizeof(size_t));
+    for (size_t p = 0; p < cl->n_particles; p++) {
+        size_t c[3];
+        for (int d = 0; d < 3; d++) {
+            double s = coordinates[3*p+d] * cl->inv_L[d];
+            s -= floor(s);
+            c[d] = (size_t) (s * (double) cl->n_cells[d]);
+            if (c[d] >= cl->n_cells[d]) c[d] = cl->n_cells[d] - 1;
+        }
+        cl->cell[p] = cellIndex(cl, c[0], c[1], c[2]);
+        cl->start[cl->cell[p] + 1]++;
+    }
+    for (size_t c = 0; c < total_cells; c++) {
+        cl->start[c + 1] += cl->start[c];
+    }
+    // start[c] is used as the insertion point of cell c, then shifted back
+    for (size_t p = 0; p < cl->n_particles; p++) {
+        const size_t a = cl->start[cl->cell[p]]++;
+        cl->order[a] = p;
+        memcpy(cl->sorted + 3*a, coordinates + 3*p, 3 * sizeof(double));
+    }
+    for (size_t c = total_cells; c > 0; c--) {
+        cl->start[c] = cl->start[c - 1];
+    }
+    cl->start[0] = 0;
+}
+
+void forEachPairCellList(const CellList* cl, PairCallback f, void* ctx) {
+    const double rc2 = cl->cutoff * cl->cutoff;
+    const size_t* nc = cl->n_cells;
+    const int use_stencil = nc[0] >= 3;
+    double dx, dy, dz;
+
+    for (size_t cz = 0; cz < nc[2]; cz++) {
+        for (size_t cy = 0; cy < nc[1]; cy++) {
+            for (size_t cx = 0; cx < nc[0]; cx++) {
+                const size_t c = cellIndex(cl, cx, cy, cz);
+                for (size_t a = cl->start[c]; a < cl->start[c + 1]; a++) {
+                    const size_t i = cl->order[a];
+                    // Same cell: the particles sorted after i
+                    for (size_t b = a + 1; b < cl->start[c + 1]; b++) {
+                        const size_t j = cl->order[b];
+                        const double r2 = minimumImage(cl, cl->sorted, a, b, &dx, &dy, &dz);
+                        if (r2 < rc2) f(i, j, dx, dy, dz, r2, ctx);
+                    }
+                    if (!use_stencil) continue;
+                    for (int s = 0; s < 13; s++) {
+                        const size_t n = cellIndex(cl, (cx + nc[0] + HALF_STENCIL[s][0]) % nc[0],
+                                                   (cy + nc[1] + HALF_STENCIL[s][1]) % nc[1],
+                                                   (cz + nc[2] + HALF_STENCIL[s][2]) % nc[2]);
+                        for (size_t b = cl->start[n]; b < cl->start[n + 1]; b++) {
+                            const size_t j = cl->order[b];
+                            const double r2 = minimumImage(cl, cl->sorted, a, b, &dx, &dy, &dz);
+                            if (r2 < rc2) f(i, j, dx, dy, dz, r2, ctx);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void freeCellList(CellList* cl) {
+    free(cl->start);
+    free(cl->order);
+    free(cl->cell);
+    free(cl->sorted);
+    cl->sorted = NULL;
+    cl->start = NULL;
+    cl->order = NULL;
+    cl->cell = NULL;
+}
+
+int initVerletList(VerletList* vl, const double* box_lengths, double cutoff, double skin, size_t n_particles) {
+    memset(vl, 0, sizeof(VerletList));
+    if (!(skin >= 0.)) {
+        fprintf(stderr, "Error: Negative Verlet skin %lf.\n", skin);
+        return -1;
+    }
+    if (initCellList(&vl->cells, box_lengths, cutoff + skin, n_particles) != 0) {
+        return -1;
+    }
+    vl->cutoff = cutoff;
+    vl->skin = skin;
+    vl->n_particles = n_particles;
+    vl->capacity = 16 * (n_particles > 0 ? n_particles : 1);
+    vl->offsets = malloc((n_particles + 1) * sizeof(size_t));
+    vl->neighbours = malloc(vl->capacity * sizeof(size_t));
+    vl->reference = malloc((n_particles > 0 ? 3 * n_particles : 1) * sizeof(double));
+    if (!vl->offsets || !vl->neighbours || !vl->reference) {
+        fprintf(stderr, "Error: Memory allocation failed for a Verlet list of %zu particles.\n", n_particles);
+        freeVerletList(vl);
+        return -1;
+    }
+    return 0;
+}
+
+// Build passes of the Verlet list: count the neighbours of each particle, then store them
+static void countNeighbour(size_t i, size_t j, double dx, double dy, double dz, double r2, void* ctx) {
+    (void) dx; (void) dy; (void) dz; (void) r2;
+    VerletList* vl = ctx;
+    vl->offsets[(i < j ? i : j) + 1]++;
+}
+
+static void storeNeighbour(size_t i, size_t j, double dx, double dy, double dz, double r2, void* ctx) {
+    (void) dx; (void) dy; (void) dz; (void) r2;
+    VerletList* vl = ctx;
+    const size_t first = i < j ? i : j;
+    vl->neighbours[vl->offsets[first]++] = i < j ? j : i;
+}
+
+int buildVerletList(VerletList* vl, const double* coordinates) {
+    // Two sweeps of the cell list of side cutoff + skin, in cell order (neighbouring particles are
+    // visited together, which keeps the sweeps cache friendly), fill the list as CSR with exact size
+    buildCellList(&vl->cells, coordinates);
+
+    memset(vl->offsets, 0, (vl->n_particles + 1) * sizeof(size_t));
+    forEachPairCellList(&vl->cells, countNeighbour, vl);
+    for (size_t i = 0; i < vl->n_particles; i++) {
+        vl->offsets[i + 1] += vl->offsets[i];
+    }
+
+    const size_t n_pairs = vl->offsets[vl->n_particles];
+    if (n_pairs > vl->capacity) {
+        size_t* grown = realloc(vl->neighbours, n_pairs * sizeof(size_t));
+        if (!grown) {
+            fprintf(stderr, "Error: Memory allocation failed for %zu neighbours.\n", n_pairs);
+            return -1;
+        }
+        vl->neighbours = grown;
+        vl->capacity = n_pairs;
+    }
+
+    // offsets[i] is used as the insertion point of particle i, then shifted back
+    forEachPairCellList(&vl->cells, storeNeighbour, vl);
+    for (size_t i = vl->n_particles; i > 0; i--) {
+        vl->offsets[i] = vl->offsets[i - 1];
+    }
+    vl->offsets[0] = 0;
+
+    memcpy(vl->reference, coordinates, 3 * vl->n_particles * sizeof(double));
+    vl->n_builds++;
+    return 0;
+}
+
+int updateVerletList(VerletList* vl, const double* coordinates) {
+    if (vl->n_builds == 0) {
+        return buildVerletList(vl, coordinates) == 0 ? 1 : -1;
+    }
+    const double limit2 = 0.25 * vl->skin * vl->skin;
+    const CellList* cl = &vl->cells;
+    double max2 = 0.;
+    for (size_t i = 0; i < vl->n_particles; i++) {
+        double d[3];
+        for (int k = 0; k < 3; k++) {
+            d[k] = coordinates[3*i+k] - vl->reference[3*i+k];
+            d[k] -= cl->L[k] * nearbyint(d[k] * cl->inv_L[k]);
+        }
+        const double r2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+        if (r2 > max2) max2 = r2;
+    }
+    if (max2 <= limit2) {
+        return 0;
+    }
+    return buildVerletList(vl, coordinates) == 0 ? 1 : -1;
+}
+
+void forEachPairVerletList(const VerletList* vl, const double* coordinates, PairCallback f, void* ctx) {
+    const double rc2 = vl->cutoff * vl->cutoff;
+    double dx, dy, dz;
+    for (size_t i = 0; i < vl->n_particles; i++) {
+        for (size_t k = vl->offsets[i]; k < vl->offsets[i+1]; k++) {
+            const size_t j = vl->neighbours[k];
+            const double r2 = minimumImage(&vl->cells, coordinates, i, j, &dx, &dy, &dz);
+            if (r2 < rc2) f(i, j, dx, dy, dz, r2, ctx);
+        }
+    }
+}
+
+void freeVerletList(VerletList* vl) {
+    freeCellList(&vl->cells);
+    free(vl->offsets);
+    free(vl->neighbours);
+    free(vl->reference);
+    vl->offsets = NULL;
+    vl->neighbours = NULL;
+    vl->reference = NULL;
+    vl->capacity = 0;
+}
@@ -0,0 +1,121 @@
+// neighbours.h
+// Linked-cell grid and Verlet neighbour list for short-range pair interactions in a periodic box.
+//
+#pragma once
+#include <stddef.h>
+
+/** @file neighbours.h
+ *  @brief O(N) neighbour search for a cutoff much smaller than the box
+ *
+ *  The box is orthorhombic and periodic, with sides `box_lengths[0..2]`; coordinates do not need
+ *  to be wrapped. Distances use the minimum image convention, so the cutoff (plus skin) must not
+ *  exceed half of the shortest side. Boxes with fewer than 3 cells along a side fall back to a
+ *  single cell, i.e. to all pairs.
+ */
+
+/**
+ * @brief Called for every pair closer than the cutoff
+ * @param i, j indices of the two particles (each pair is visited once)
+ * @param dx, dy, dz minimum image of r_j - r_i
+ * @param r2 squared distance
+ * @param ctx user data
+ */
+typedef void (*PairCallback)(size_t i, size_t j, double dx, double dy, double dz, double r2, void* ctx);
+
+/**
+ * @struct CellList
+ * @brief Cell grid with the particles sorted by cell: the particles of cell c are
+ * order[start[c]] ... order[start[c+1]-1], in increasing order
+ * @param n_cells number of cells along each side, each at least `cutoff` wide
+ * @param start offset of each cell in `order`, n_cells[0]*n_cells[1]*n_cells[2] + 1 entries
+ * @param order particle indices sorted by cell
+ * @param cell cell of each particle
+ * @param sorted coordinates in the order of `order`, so that the particles of a cell are contiguous
+ */
+typedef struct CellList {
+    double L[3];
+    double inv_L[3];
+    double cutoff;
+    size_t n_cells[3];
+    size_t n_particles;
+    size_t* start;
+    size_t* order;
+    size_t* cell;
+    double* sorted;
+} CellList;
+
+/**
+ * @brief Allocate a grid of cells at least `cutoff` wide for `n_particles` particles
+ * @return 0 on success, -1 on failure
+ */
+int initCellList(CellList* cl, const double* box_lengths, double cutoff, size_t n_particles);
+
+/**
+ * @brief Sort the particles by cell (counting sort), O(N)
+ * @param coordinates 3*n_particles coordinates
+ */
+void buildCellList(CellList* cl, const double* coordinates);
+
+/**
+ * @brief Call `f` on every pair closer than the cutoff, visiting each cell and half of its neighbours.
+ * Distances are those of the coordinates given to the last `buildCellList`
+ */
+void forEachPairCellList(const CellList* cl, PairCallback f, void* ctx);
+
+/**
+ * @brief Frees the memory associated to the cell list
+ * @warning does NOT free the struct itself
+ */
+void freeCellList(CellList* cl);
+
+/**
+ * @struct VerletList
+ * @brief Half neighbour list with a skin, stored as compact arrays (CSR)
+ *
+ * The neighbours j > i of particle i within cutoff + skin are neighbours[offsets[i]] ...
+ * neighbours[offsets[i+1]-1]. The list stays valid until a particle moves by more than skin/2
+ * from its position at the last build, which `updateVerletList` checks.
+ * @param reference coordinates at the last build
+ * @param n_builds number of times the list was built
+ */
+typedef struct VerletList {
+    double cutoff;
+    double skin;
+    size_t n_particles;
+    size_t* offsets;
+    size_t* neighbours;
+    size_t capacity;
+    double* reference;
+    size_t n_builds;
+    CellList cells;
+} VerletList;
+
+/**
+ * @brief Allocate a Verlet list for `n_particles` particles
+ * @return 0 on success, -1 on failure
+ */
+int initVerletList(VerletList* vl, const double* box_lengths, double cutoff, double skin, size_t n_particles);
+
+/**
+ * @brief Rebuild the list from scratch with a cell list of side cutoff + skin, O(N)
+ * @return 0 on success, -1 on failure
+ */
+int buildVerletList(VerletList* vl, const double* coordinates);
+
+/**
+ * @brief Rebuild the list only if a particle moved by more than skin/2 since the last build
+ * (or if it was never built)
+ * @return 1 if the list was rebuilt, 0 if it is still valid, -1 on failure
+ */
+int updateVerletList(VerletList* vl, const double* coordinates);
+
+/**
+ * @brief Call `f` on every pair of the list closer than the cutoff
+ */
+void forEachPairVerletList(const VerletList* vl, const double* coordinates, PairCallback f, void* ctx);
+
+/**
+ * @brief Frees the memory associated to the Verlet list
+ * @warning does NOT free the struct itself
+ */
+void freeVerletList(VerletList* vl);
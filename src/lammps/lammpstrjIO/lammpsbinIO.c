@@ -0,0 +1,246 @@
+/**
+ * @file lammpsbinIO.c
+ * @brief Writer of the native binary trajectory format described in lammpsbinIO.h
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "lammpsbinIO.h"
+#include "trjcodec.h"
+
+// Size of the header plus topology, rounded up to the alignment of the coordinate blocks
+static int64_t coordinatesOffset(size_t n_particles) {
+    const int64_t raw = (int64_t) sizeof(LammpsBinHeader) + 3 * (int64_t) n_particles * (int64_t) sizeof(int64_t);
+    return (raw + LAMMPSBIN_ALIGNMENT - 1) / LAMMPSBIN_ALIGNMENT * LAMMPSBIN_ALIGNMENT;
+}
+
+static int writeLammpsBinHeader(LammpsBinFile* lb, int64_t trailer_offset) {
+    LammpsBinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LAMMPSBIN_MAGIC, sizeof(header.magic));
+    header.version = LAMMPSBIN_VERSION;
+    header.flags = lb->flags;
+    header.n_atoms = (int64_t) lb->n_particles;
+    header.n_frames = (int64_t) lb->n_frames;
+    header.coordinates_offset = coordinatesOffset(lb->n_particles);
+    header.trailer_offset = trailer_offset;
+    header.precision = lb->precision;
+    header.keyframe_interval = (int64_t) lb->keyframe_interval;
+
+    if (fseek(lb->fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, lb->fp) != 1) {
+        perror("Failed to write binary trajectory header");
+        return -1;
+    }
+    return 0;
+}
+
+int initLammpsBinData(LammpsBinFile* lb, const char* filename, size_t n_particles, double boxL, int single_precision) {
+    if (!lb || !filename) return -1;
+
+    memset(lb, 0, sizeof(*lb));
+    lb->n_particles = n_particles;
+    lb->boxL = boxL;
+    lb->flags = single_precision ? LAMMPSBIN_FLOAT32 : 0u;
+
+    lb->fp = fopen(filename, "wb+");
+    if (!lb->fp) {
+        perror("Failed to open file for writing");
+        return -1;
+    }
+
+    if (single_precision) {
+        lb->scratch = malloc(3 * n_particles * sizeof(float));
+        if (!lb->scratch) {
+            fprintf(stderr, "Failed to allocate memory for the float32 buffer\n");
+            fclose(lb->fp);
+            lb->fp = NULL;
+            return -1;
+        }
+    }
+
+    // Header with no frames and the default topology
+    int64_t* topology = malloc(3 * n_particles * sizeof(int64_t));
+    if (!topology) {
+        fprintf(stderr, "Failed to allocate memory for the topology\n");
+        freeLammpsBinData(lb);
+        return -1;
+    }
+    for (size_t i = 0; i < n_particles; i++) {
+        topology[i]                 = (int64_t) i + 1;
+        topology[n_particles + i]   = 1;
+        topology[2*n_particles + i] = 1;
+    }
+    int status = writeLammpsBinHeader(lb, 0);
+    if (status == 0 && fwrite(topology, sizeof(int64_t), 3 * n_particles, lb->fp) != 3 * n_particles) {
+        perror("Failed to write the topology");
+        status = -1;
+    }
+    free(topology);
+
+    // Zero padding up to the first coordinate block, so that the file is complete even without frames
+    static const char padding[LAMMPSBIN_ALIGNMENT] = {0};
+    lb->position = coordinatesOffset(n_particles);
+    const size_t padding_bytes = (size_t) (lb->position - (int64_t) sizeof(LammpsBinHeader))
+                                 - 3 * n_particles * sizeof(int64_t);
+    if (status == 0 && fwrite(padding, 1, padding_bytes, lb->fp) != padding_bytes) {
+        perror("Failed to write the topology");
+        status = -1;
+    }
+    if (status != 0) {
+        freeLammpsBinData(lb);
+    }
+    return status;
+}
+
+int initLammpsBinDataCompressed(LammpsBinFile* lb, const char* filename, size_t n_particles, double boxL,
+                                double precision, size_t keyframe_interval) {
+    if (!(precision > 0.0)) {
+        fprintf(stderr, "The precision must be positive\n");
+        return -1;
+    }
+    if (initLammpsBinData(lb, filename, n_particles, boxL, 0) != 0) {
+        return -1;
+    }
+    lb->flags |= LAMMPSBIN_COMPRESSED;
+    lb->precision = precision;
+    lb->keyframe_interval = keyframe_interval;
+    lb->reference = calloc(3 * n_particles, sizeof(int64_t));
+    lb->encoded = malloc(trjCodecMaxBytes(3 * n_particles));
+    if (!lb->reference || !lb->encoded || writeLammpsBinHeader(lb, 0) != 0
+        || fseek(lb->fp, lb->position, SEEK_SET) != 0) {
+        fprintf(stderr, "Failed to set up the compressed trajectory\n");
+        freeLammpsBinData(lb);
+        return -1;
+    }
+    return 0;
+}
+
+int setLammpsBinTopology(LammpsBinFile* lb, const int64_t* atomIds, const int64_t* moleculeIds, const int64_t* atomTypes) {
+    if (!lb || !lb->fp) return -1;
+    if (lb->n_frames > 0) {
+        fprintf(stderr, "The topology must be set before writing frames\n");
+        return -1;
+    }
+
+    const size_t n = lb->n_particles;
+    const int64_t* columns[3] = {atomIds, moleculeIds, atomTypes};
+    for (int c = 0; c < 3; c++) {
+        if (!columns[c]) continue;
+        const long offset = (long) (sizeof(LammpsBinHeader) + c * n * sizeof(int64_t));
+        if (fseek(lb->fp, offset, SEEK_SET) != 0 || fwrite(columns[c], sizeof(int64_t), n, lb->fp) != n) {
+            perror("Failed to write the topology");
+            return -1;
+        }
+    }
+    return fseek(lb->fp, lb->position, SEEK_SET) == 0 ? 0 : -1;
+}
+
+int writeLammpsBinFrameAt(LammpsBinFile* lb, int64_t timestep, const double* box, const double* coordinates) {
+    if (!lb || !lb->fp || !box || !coordinates) return -1;
+
+    // Per-frame metadata goes to the trailer, kept in memory until the file is closed
+    if (lb->n_frames == lb->frames_capacity) {
+        const size_t capacity = lb->frames_capacity ? 2 * lb->frames_capacity : 1024;
+        int64_t* timesteps = realloc(lb->timesteps, capacity * sizeof(int64_t));
+        if (timesteps) lb->timesteps = timesteps;
+        double* boxes = realloc(lb->boxes, 6 * capacity * sizeof(double));
+        if (boxes) lb->boxes = boxes;
+        int64_t* offsets = realloc(lb->offsets, capacity * sizeof(int64_t));
+        if (offsets) lb->offsets = offsets;
+        if (!timesteps || !boxes || !offsets) {
+            fprintf(stderr, "Failed to allocate memory for %zu frames\n", capacity);
+            return -1;
+        }
+        lb->frames_capacity = capacity;
+    }
+
+    const size_t n = 3 * lb->n_particles;
+    size_t bytes;
+    int ok;
+    if (lb->flags & LAMMPSBIN_COMPRESSED) {
+        const int keyframe = (lb->n_frames == 0)
+                          || (lb->keyframe_interval > 0 && lb->n_frames % lb->keyframe_interval == 0);
+        bytes = encodeTrjFrame(coordinates, n, lb->precision, lb->reference, keyframe, lb->encoded);
+        if (bytes == 0 && n > 0) {
+            fprintf(stderr, "Coordinates cannot be quantised with precision %g\n", lb->precision);
+            return -1;
+        }
+        ok = fwrite(lb->encoded, 1, bytes, lb->fp) == bytes;
+    } else if (lb->flags & LAMMPSBIN_FLOAT32) {
+        for (size_t i = 0; i < n; i++) {
+            lb->scratch[i] = (float) coordinates[i];
+        }
+        bytes = n * sizeof(float);
+        ok = fwrite(lb->scratch, sizeof(float), n, lb->fp) == n;
+    } else {
+        bytes = n * sizeof(double);
+        ok = fwrite(coordinates, sizeof(double), n, lb->fp) == n;
+    }
+    if (!ok) {
+        perror("Failed to write frame");
+        return -1;
+    }
+
+    lb->offsets[lb->n_frames] = lb->position;
+    lb->position += (int64_t) bytes;
+    lb->timesteps[lb->n_frames] = timestep;
+    memcpy(lb->boxes + 6 * lb->n_frames, box, 6 * sizeof(double));
+    lb->n_frames += 1;
+    return 0;
+}
+
+void writeLammpsBinFrame(LammpsBinFile* lb, const double* coordinates) {
+    if (!lb) return;
+    const double half = 0.5 * lb->boxL;
+    const double box[6] = {-half, half, -half, half, -half, half};
+    writeLammpsBinFrameAt(lb, (int64_t) lb->n_frames, box, coordinates);
+}
+
+int closeLammpsBinData(LammpsBinFile* lb) {
+    if (!lb || !lb->fp) return -1;
+
+    // Trailer right after the last coordinate block
+    const int64_t trailer_offset = lb->position;
+    const size_t n_offsets = (lb->flags & LAMMPSBIN_COMPRESSED) ? lb->n_frames : 0;
+
+    int status = 0;
+    if (fseek(lb->fp, trailer_offset, SEEK_SET) != 0
+        || fwrite(lb->timesteps, sizeof(int64_t), lb->n_frames, lb->fp) != lb->n_frames
+        || fwrite(lb->boxes, sizeof(double), 6 * lb->n_frames, lb->fp) != 6 * lb->n_frames
+        || fwrite(lb->offsets, sizeof(int64_t), n_offsets, lb->fp) != n_offsets
+        || writeLammpsBinHeader(lb, trailer_offset) != 0) {
+        perror("Failed to finalize binary trajectory");
+        status = -1;
+    }
+    if (fclose(lb->fp) != 0) {
+        perror("Failed to close binary trajectory");
+        status = -1;
+    }
+    lb->fp = NULL;
+    return status;
+}
+
+void freeLammpsBinData(LammpsBinFile* lb) {
+    if (!lb) return;
+
+    if (lb->fp) {
+        closeLammpsBinData(lb);
+    }
+
+    free(lb->timesteps);
+    free(lb->boxes);
+    free(lb->offsets);
+    free(lb->scratch);
+    free(lb->reference);
+    free(lb->encoded);
+    lb->timesteps = NULL;
+    lb->boxes = NULL;
+    lb->offsets = NULL;
+    lb->scratch = NULL;
+    lb->reference = NULL;
+    lb->encoded = NULL;
+    lb->frames_capacity = 0;
+    lb->n_frames = 0;
+    lb->n_particles = 0;
+    lb->boxL = 0.0;
+}
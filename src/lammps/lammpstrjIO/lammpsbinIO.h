@@ -0,0 +1,146 @@
+// lammpsbinIO.h
+// Native binary trajectory format.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file lammpsbinIO.h
+ * @brief Native binary trajectory format and its writer.
+ *
+ * Layout of a `.ggtrj` file (native endianness):
+ * - `LammpsBinHeader` (64 bytes)
+ * - topology: atom ids, molecule ids and types (`n_atoms` int64 each)
+ * - coordinate blocks, starting at `coordinates_offset` (64-byte aligned): one block of
+ *   3*n_atoms values (double, or float with `LAMMPSBIN_FLOAT32`) per frame, frame after frame
+ * - trailer, at `trailer_offset`: the timestep of each frame (int64) followed by the box of
+ *   each frame (6 doubles, {xlo, xhi, ylo, yhi, zlo, zhi})
+ *
+ * The coordinate blocks are contiguous, so a reader can map the file and use them as a
+ * frame-major T x N x 3 array without copying.
+ *
+ * With `LAMMPSBIN_COMPRESSED` each block is instead a variable size frame encoded by trjcodec.h
+ * (quantised to `precision`, delta encoded against the previous frame except every
+ * `keyframe_interval` frames), and the trailer ends with the byte offset of each block (int64).
+ */
+
+#define LAMMPSBIN_MAGIC     "GGTRJBIN"
+#define LAMMPSBIN_VERSION   1
+#define LAMMPSBIN_FLOAT32    0x1u  ///< Coordinates are stored as float instead of double
+#define LAMMPSBIN_COMPRESSED 0x2u  ///< Coordinates are quantised and delta encoded (trjcodec.h)
+#define LAMMPSBIN_ALIGNMENT 64
+
+/**
+ * @struct LammpsBinHeader
+ * @brief Fixed size header at the start of a binary trajectory
+ */
+typedef struct LammpsBinHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int64_t n_atoms;
+    int64_t n_frames;
+    int64_t coordinates_offset;
+    int64_t trailer_offset;
+    double precision;           ///< Quantisation step of compressed files
+    int64_t keyframe_interval;  ///< Distance between frames encoded without delta in compressed files
+} LammpsBinHeader;
+
+/**
+ * @struct LammpsBinFile
+ * @brief Descriptor of a binary trajectory being written.
+ *
+ * Usage:
+ * 1. Initialize with `initLammpsBinData`.
+ * 2. Optionally set ids, molecule ids and types with `setLammpsBinTopology`.
+ * 3. Write frames with `writeLammpsBinFrame` or `writeLammpsBinFrameAt`.
+ * 4. Finalize with `closeLammpsBinData`, then free resources with `freeLammpsBinData`.
+ */
+typedef struct LAMMPS_BIN_FILE {
+    FILE* fp;
+    size_t n_frames;
+
+    size_t n_particles;
+    double boxL;
+    uint32_t flags;
+
+    int64_t* timesteps;     ///< Timestep of each frame written, flushed in the trailer
+    double* boxes;          ///< Box of each frame written, flushed in the trailer
+    int64_t* offsets;       ///< Offset of each compressed frame, flushed in the trailer
+    size_t frames_capacity;
+    int64_t position;       ///< Offset of the next coordinate block
+    float* scratch;         ///< Conversion buffer for float32 output
+
+    double precision;       ///< Quantisation step (compressed files)
+    size_t keyframe_interval;
+    int64_t* reference;     ///< Quantised previous frame (compressed files)
+    uint8_t* encoded;       ///< Encoding buffer (compressed files)
+} LammpsBinFile;
+
+/**
+ * @brief Create a binary trajectory file.
+ *
+ * The topology defaults to id = 1..n_particles, mol = 1, type = 1, as in `writeLammpsTrjFrame`.
+ *
+ * @param lb Pointer to the LammpsBinFile struct to initialize.
+ * @param filename Name of the file to create.
+ * @param n_particles Number of particles of every frame.
+ * @param boxL Length of the cubic box used by `writeLammpsBinFrame` (box from -boxL/2 to +boxL/2).
+ * @param single_precision If non-zero coordinates are stored as float.
+ * @return 0 on success, -1 on failure
+ */
+int initLammpsBinData(LammpsBinFile* lb, const char* filename, size_t n_particles, double boxL, int single_precision);
+
+/**
+ * @brief Create a compressed binary trajectory file.
+ *
+ * Coordinates are stored with an absolute error of at most precision/2.
+ *
+ * @param lb Pointer to the LammpsBinFile struct to initialize.
+ * @param filename Name of the file to create.
+ * @param n_particles Number of particles of every frame.
+ * @param boxL Length of the cubic box used by `writeLammpsBinFrame`.
+ * @param precision Quantisation step, in the units of the coordinates (e.g. 1e-3).
+ * @param keyframe_interval Every `keyframe_interval` frames a frame is stored without delta
+ *        encoding, which bounds the frames to decode to reach any frame (0: first frame only).
+ * @return 0 on success, -1 on failure
+ */
+int initLammpsBinDataCompressed(LammpsBinFile* lb, const char* filename, size_t n_particles, double boxL,
+                                double precision, size_t keyframe_interval);
+
+/**
+ * @brief Store atom ids, molecule ids and types. Must be called before the first frame.
+ * @return 0 on success, -1 on failure
+ */
+int setLammpsBinTopology(LammpsBinFile* lb, const int64_t* atomIds, const int64_t* moleculeIds, const int64_t* atomTypes);
+
+/**
+ * @brief Append a frame using the frame counter as timestep and the cubic box of the descriptor.
+ * @param coordinates Flat array of particle coordinates of size 3 * n_particles.
+ */
+void writeLammpsBinFrame(LammpsBinFile* lb, const double* coordinates);
+
+/**
+ * @brief Append a frame with an explicit timestep and box.
+ * @param box Box bounds as {xlo, xhi, ylo, yhi, zlo, zhi}
+ * @param coordinates Flat array of particle coordinates of size 3 * n_particles.
+ * @return 0 on success, -1 on failure
+ */
+int writeLammpsBinFrameAt(LammpsBinFile* lb, int64_t timestep, const double* box, const double* coordinates);
+
+/**
+ * @brief Write the trailer, finalize the header and close the file. Further frames are not written.
+ * @warning The file is not readable until this succeeds.
+ * @return 0 on success, -1 on failure
+ */
+int closeLammpsBinData(LammpsBinFile* lb);
+
+/**
+ * @brief Close the file with `closeLammpsBinData` if still open, then free the descriptor's buffers.
+ * @warning Use `closeLammpsBinData` first to know whether the file was finalized.
+ */
+void freeLammpsBinData(LammpsBinFile* lb);
@@ -5,62 +5,90 @@
  * Provides utilities to initialize a LAMMPS data file descriptor and write
  * particle coordinates frame by frame in a format suitable for visualization in VMD.
  */
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "lammpstrjIO.h"
+#include "numformat.h"
+#include "PingPongBuffer.h"
 
-void initLammpsTrjData(LammpsTrjFile *ld, const char *filename, size_t n_particles, double boxL) {
-    if (!ld || !filename) return;
+// Longest atom line: three integers and three `%f` values, the latter up to FORMAT_FIXED6_MAX
+#define LAMMPSTRJ_MAX_LINE 1100
+#define LAMMPSTRJ_MAX_HEADER 512
+
+int initLammpsTrjDataBuffered(LammpsTrjFile *ld, const char *filename, size_t n_particles, double boxL, size_t buffer_size) {
+    if (!ld || !filename) return -1;
+
+    memset(ld, 0, sizeof(*ld));
 
     // Allocate memory for the filename string (+1 for null terminator)
     ld->filename = malloc(strlen(filename) + 1);
     if (!ld->filename) {
         fprintf(stderr, "Failed to allocate memory for filename: %s", filename);
-        return;
+        return -1;
     }
     strcpy(ld->filename, filename);
     ld->n_frames = 0;
     ld->n_particles = n_particles;
     ld->boxL = boxL;
-}
 
-
-void writeLammpsTrjFrame(LammpsTrjFile *ld, double *coordinates) {
-    if (!ld || !coordinates) return;
-
-    FILE *fp;
-    if (ld->n_frames == 0) {
-        // First frame: create file
-        fp = fopen(ld->filename, "w");
-        if (!fp) {
-            perror("Failed to open file for writing");
-            return;
-        }
-    } else {
-        // Append mode for subsequent frames
-        fp = fopen(ld->filename, "a");
-        if (!fp) {
-            perror("Failed to open file for appending");
-            return;
+    ld->fp = fopen(ld->filename, "w");
+    if (!ld->fp) {
+        perror("Failed to open file for writing");
+        freeLammpsTrjData(ld);
+        return -1;
+    }
+    if (buffer_size > 0) {
+        ld->io_buffer = malloc(buffer_size);
+        if (ld->io_buffer) {
+            setvbuf(ld->fp, ld->io_buffer, _IOFBF, buffer_size);
         }
     }
 
-    fprintf(fp, "ITEM: TIMESTEP\n");
-    fprintf(fp,"%zu\n", ld->n_frames);
+    // Typical frame: short integers and coordinates below 1e6
+    ld->frame_capacity = LAMMPSTRJ_MAX_HEADER + n_particles * 64 + LAMMPSTRJ_MAX_LINE;
+    ld->frame_buffer = malloc(ld->frame_capacity);
+    if (!ld->frame_buffer) {
+        fprintf(stderr, "Failed to allocate memory for the frame buffer\n");
+        freeLammpsTrjData(ld);
+        return -1;
+    }
+    return 0;
+}
 
-    fprintf(fp, "ITEM: NUMBER OF ATOMS\n");
-    fprintf(fp, "%zu\n", ld->n_particles);
+void initLammpsTrjData(LammpsTrjFile *ld, const char *filename, size_t n_particles, double boxL) {
+    initLammpsTrjDataBuffered(ld, filename, n_particles, boxL, LAMMPSTRJ_DEFAULT_BUFFER_SIZE);
+}
 
-    fprintf(fp, "ITEM: BOX BOUNDS pp pp pp\n");
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
-    fprintf(fp, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
 
-    fprintf(fp, "ITEM: ATOMS id mol type xu yu zu\n");
+// Format a frame in `ld->frame_buffer` and write it with a single call
+static int writeFrameText(LammpsTrjFile *ld, const double *coordinates, size_t timestep) {
+    char *o = ld->frame_buffer;
+    o += sprintf(o, "ITEM: TIMESTEP\n%zu\n", timestep);
+    o += sprintf(o, "ITEM: NUMBER OF ATOMS\n%zu\n", ld->n_particles);
+    o += sprintf(o, "ITEM: BOX BOUNDS pp pp pp\n");
+    for (int d = 0; d < 3; d++) {
+        o += sprintf(o, "%e %e\n", -0.5*ld->boxL, 0.5*ld->boxL);
+    }
+    o += sprintf(o, "ITEM: ATOMS id mol type xu yu zu\n");
 
     for (size_t i = 0; i < ld->n_particles; ++i) {
+        // Grow the buffer if a line with huge values might not fit
+        size_t used = (size_t) (o - ld->frame_buffer);
+        if (ld->frame_capacity - used < LAMMPSTRJ_MAX_LINE) {
+            const size_t capacity = 2 * ld->frame_capacity;
+            char *buffer = realloc(ld->frame_buffer, capacity);
+            if (!buffer) {
+                fprintf(stderr, "Failed to allocate memory for the frame buffer\n");
+                return -1;
+            }
+            ld->frame_buffer = buffer;
+            ld->frame_capacity = capacity;
+            o = buffer + used;
+        }
+
         size_t id = i+1;
         size_t molId = 1;
         size_t type = 1;
@@ -69,21 +97,217 @@ void writeLammpsTrjFrame(LammpsTrjFile *ld, double *coordinates) {
         double yu = coordinates[3*i+1];
         double zu = coordinates[3*i+2];
 
-        fprintf(fp, "%zu %zu %zu %f %f %f\n", id, molId, type, xu, yu, zu);
+        // Same text as "%zu %zu %zu %f %f %f\n"
+        o = formatUnsigned(o, id);    *o++ = ' ';
+        o = formatUnsigned(o, molId); *o++ = ' ';
+        o = formatUnsigned(o, type);  *o++ = ' ';
+        o = formatFixed6(o, xu);      *o++ = ' ';
+        o = formatFixed6(o, yu);      *o++ = ' ';
+        o = formatFixed6(o, zu);      *o++ = '\n';
+    }
+
+    const size_t len = (size_t) (o - ld->frame_buffer);
+    if (fwrite(ld->frame_buffer, 1, len, ld->fp) != len) {
+        perror("Failed to write frame");
+        return -1;
     }
+    return 0;
+}
+
+
+/**
+ * @brief State of the background writer.
+ *
+ * `snapshots.next` belongs to the simulation thread, which copies a frame into it and swaps the
+ * buffers; `snapshots.prev` then belongs to the I/O thread until `busy` goes back to 0.
+ */
+struct LammpsTrjAsync {
+    PingPongBuffer snapshots;
+    size_t timestep;                ///< Timestep of the snapshot in `prev`
+    int busy;                       ///< A snapshot is waiting in, or being written from, `prev`
+    int stop;
+    int error;
+    LammpsTrjBackPressure policy;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;            ///< Signaled when a snapshot is ready or on stop
+    pthread_cond_t done;            ///< Signaled when the I/O thread released `prev`
+};
+
+static void *asyncWriterLoop(void *arg) {
+    LammpsTrjFile *ld = arg;
+    struct LammpsTrjAsync *async = ld->async;
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (!async->busy && !async->stop) {
+            pthread_cond_wait(&async->work, &async->lock);
+        }
+        if (!async->busy) {
+            break; // Stopped with nothing left to write
+        }
+        pthread_mutex_unlock(&async->lock);
+
+        const int status = writeFrameText(ld, async->snapshots.prev, async->timestep);
+
+        pthread_mutex_lock(&async->lock);
+        if (status != 0) async->error = 1;
+        async->busy = 0;
+        pthread_cond_signal(&async->done);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+// Wait until the I/O thread is idle
+static void waitAsyncWriter(struct LammpsTrjAsync *async) {
+    pthread_mutex_lock(&async->lock);
+    while (async->busy) {
+        pthread_cond_wait(&async->done, &async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+}
+
+int startLammpsTrjAsync(LammpsTrjFile *ld, LammpsTrjBackPressure policy) {
+    if (!ld || !ld->fp || ld->async) return -1;
 
-    fclose(fp);
+    struct LammpsTrjAsync *async = calloc(1, sizeof(struct LammpsTrjAsync));
+    if (!async) {
+        fprintf(stderr, "Failed to allocate memory for the asynchronous writer\n");
+        return -1;
+    }
+    initPingPongBuffer(&async->snapshots, 3 * ld->n_particles);
+    if (!async->snapshots.data) {
+        fprintf(stderr, "Failed to allocate memory for the snapshots\n");
+        free(async);
+        return -1;
+    }
+    async->policy = policy;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->work, NULL);
+    pthread_cond_init(&async->done, NULL);
+
+    ld->async = async;
+    if (pthread_create(&async->thread, NULL, asyncWriterLoop, ld) != 0) {
+        fprintf(stderr, "Failed to start the asynchronous writer\n");
+        ld->async = NULL;
+        pthread_cond_destroy(&async->done);
+        pthread_cond_destroy(&async->work);
+        pthread_mutex_destroy(&async->lock);
+        freePingPongBuffer(&async->snapshots);
+        free(async);
+        return -1;
+    }
+    return 0;
+}
+
+int stopLammpsTrjAsync(LammpsTrjFile *ld) {
+    if (!ld || !ld->async) return -1;
+    struct LammpsTrjAsync *async = ld->async;
+
+    // The I/O thread writes what is pending, then exits
+    pthread_mutex_lock(&async->lock);
+    async->stop = 1;
+    pthread_cond_signal(&async->work);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+
+    const int status = async->error ? -1 : 0;
+    pthread_cond_destroy(&async->done);
+    pthread_cond_destroy(&async->work);
+    pthread_mutex_destroy(&async->lock);
+    freePingPongBuffer(&async->snapshots);
+    free(async);
+    ld->async = NULL;
+    return status;
+}
+
+
+void writeLammpsTrjFrame(LammpsTrjFile *ld, double *coordinates) {
+    if (!ld || !coordinates) return;
+    if (!ld->fp) {
+        fprintf(stderr, "Failed to write frame: %s is closed\n", ld->filename ? ld->filename : "trajectory");
+        return;
+    }
+
+    // Dropped frames still advance the timestep, so the time axis of the file stays correct
+    const size_t timestep = ld->n_frames + ld->n_dropped;
+
+    if (!ld->async) {
+        if (writeFrameText(ld, coordinates, timestep) == 0) {
+            ld->n_frames += 1;
+        }
+        return;
+    }
+
+    struct LammpsTrjAsync *async = ld->async;
+    pthread_mutex_lock(&async->lock);
+    if (async->busy && async->policy == LAMMPSTRJ_DROP) {
+        pthread_mutex_unlock(&async->lock);
+        ld->n_dropped += 1;
+        return;
+    }
+    while (async->busy) {
+        pthread_cond_wait(&async->done, &async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    // `next` is ours: copy outside the lock, then hand it over
+    memcpy(async->snapshots.next, coordinates, 3 * ld->n_particles * sizeof(double));
+
+    pthread_mutex_lock(&async->lock);
+    PINGPONG_BUFFER_NEXT_STEP(&async->snapshots);
+    async->timestep = timestep;
+    async->busy = 1;
+    pthread_cond_signal(&async->work);
+    pthread_mutex_unlock(&async->lock);
     ld->n_frames += 1;
 }
 
 
+int flushLammpsTrjData(LammpsTrjFile *ld) {
+    if (!ld || !ld->fp) return -1;
+    if (ld->async) {
+        waitAsyncWriter(ld->async);
+    }
+    return fflush(ld->fp) == 0 ? 0 : -1;
+}
+
+
+int closeLammpsTrjData(LammpsTrjFile *ld) {
+    if (!ld || !ld->fp) return -1;
+    int status = 0;
+    if (ld->async && stopLammpsTrjAsync(ld) != 0) {
+        status = -1;
+    }
+    if (fclose(ld->fp) != 0) {
+        status = -1;
+    }
+    ld->fp = NULL;
+    free(ld->io_buffer);
+    ld->io_buffer = NULL;
+    if (status != 0) {
+        perror("Failed to close trajectory");
+    }
+    return status;
+}
+
+
 void freeLammpsTrjData(LammpsTrjFile *ld) {
     if (!ld) return;
 
+    if (ld->fp) {
+        closeLammpsTrjData(ld);
+    }
+
     if (ld->filename) {
         free(ld->filename);
         ld->filename = NULL;
     }
+    free(ld->frame_buffer);
+    ld->frame_buffer = NULL;
+    ld->frame_capacity = 0;
 
     ld->n_frames = 0;
     ld->n_particles = 0;
@@ -4,6 +4,19 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdio.h>
+
+#define LAMMPSTRJ_DEFAULT_BUFFER_SIZE (1 << 20)   ///< Default size of the output buffer (1 MiB)
+
+/**
+ * @brief What `writeLammpsTrjFrame` does in asynchronous mode when the previous frame is still being written
+ */
+typedef enum LammpsTrjBackPressure {
+    LAMMPSTRJ_BLOCK,    ///< Wait for the I/O thread: no frame is lost
+    LAMMPSTRJ_DROP      ///< Skip the frame and count it in `n_dropped`: the caller never waits on the disk
+} LammpsTrjBackPressure;
+
 /**
  * @struct LammpsTrjFile
  * @brief Descriptor for a LAMMPS-compatible data or trajectory file.
@@ -11,11 +24,15 @@
  * This struct stores the information needed to write particle coordinates
  * to a LAMMPS-style data file. It keeps track of the filename, the number
  * of frames written, the number of particles, and the cubic box length.
+ * The file stays open between frames, behind an output buffer of user chosen size.
  *
  * Usage:
- * 1. Initialize with `initLammpsData`.
- * 2. Write frames with `writeLammpsDatFrame`.
- * 3. Free resources with `freeLammpsData`.
+ * 1. Initialize with `initLammpsTrjData` or `initLammpsTrjDataBuffered`.
+ * 2. Write frames with `writeLammpsTrjFrame`.
+ * 3. Optionally push buffered frames to disk with `flushLammpsTrjData`.
+ * 4. Close the file and free resources with `freeLammpsTrjData`.
+ *
+ * After `startLammpsTrjAsync` frames are formatted and written by a background thread.
  */
 typedef struct LAMMPS_TRJ_FILE {
     char *filename;
@@ -24,6 +41,13 @@ typedef struct LAMMPS_TRJ_FILE {
     size_t n_particles;
     double boxL;
 
+    FILE *fp;               ///< Open handle, NULL once closed
+    char *io_buffer;        ///< stdio buffer of `fp`
+    char *frame_buffer;     ///< Text of the frame being formatted
+    size_t frame_capacity;  ///< Size of `frame_buffer`
+
+    struct LammpsTrjAsync *async;   ///< Background writer, NULL in synchronous mode
+    size_t n_dropped;               ///< Frames skipped by the LAMMPSTRJ_DROP policy
 } LammpsTrjFile;
 
 /**
@@ -39,12 +63,59 @@ typedef struct LAMMPS_TRJ_FILE {
  */
 void initLammpsTrjData(LammpsTrjFile *ld, const char *filename, size_t n_particles, double boxL);
 
+/**
+ * @brief Initialize a LAMMPS trajectory descriptor with an output buffer of `buffer_size` bytes.
+ *
+ * The file is created (truncated) immediately and kept open until `closeLammpsTrjData`
+ * or `freeLammpsTrjData`.
+ *
+ * @param ld Pointer to the LammpsTrjFile struct to initialize.
+ * @param filename Name of the LAMMPS trajectory file to create.
+ * @param n_particles Number of particles that will be stored in the file.
+ * @param boxL Length of the cubic box (assumes box from -boxL/2 to +boxL/2 in each dimension).
+ * @param buffer_size Size of the output buffer in bytes.
+ * @return 0 on success, -1 on failure
+ */
+int initLammpsTrjDataBuffered(LammpsTrjFile *ld, const char *filename, size_t n_particles, double boxL, size_t buffer_size);
+
+/**
+ * @brief Switch to asynchronous mode.
+ *
+ * `writeLammpsTrjFrame` then only copies the coordinates into a snapshot slot (a PingPongBuffer:
+ * one slot is filled by the caller while the other is written) and returns; a dedicated I/O thread
+ * formats and writes the snapshot. When a frame arrives while the previous one is still being
+ * written, `policy` decides whether the caller waits or the frame is dropped.
+ *
+ * @param ld Pointer to an initialized LammpsTrjFile.
+ * @param policy Back-pressure policy.
+ * @return 0 on success, -1 on failure
+ */
+int startLammpsTrjAsync(LammpsTrjFile *ld, LammpsTrjBackPressure policy);
+
+/**
+ * @brief Write the pending snapshot, stop the I/O thread and go back to synchronous mode.
+ * @return 0 on success, -1 if the I/O thread failed to write a frame
+ */
+int stopLammpsTrjAsync(LammpsTrjFile *ld);
+
+/**
+ * @brief Push the buffered frames to the operating system.
+ * @return 0 on success, -1 on failure
+ */
+int flushLammpsTrjData(LammpsTrjFile *ld);
+
+/**
+ * @brief Flush and close the file, stopping the I/O thread if any. Further frames are not written.
+ * @return 0 on success, -1 on failure
+ */
+int closeLammpsTrjData(LammpsTrjFile *ld);
+
 
 /**
  * @brief Free resources associated with a LammpsDat struct.
  *
- * Frees the memory allocated for the filename and resets the fields
- * of the struct. Should be called when the LammpsDat struct is no longer needed.
+ * Closes the file if still open, frees the memory allocated for the filename and buffers,
+ * and resets the fields of the struct. Should be called when the LammpsDat struct is no longer needed.
  *
  * @param ld Pointer to the LammpsDat struct to clean up.
  */
@@ -54,7 +125,8 @@ void freeLammpsTrjData(LammpsTrjFile *ld);
 /**
  * @brief Write a frame of particle coordinates to a LAMMPS-compatible file.
  *
- * The function appends a frame to the file. If it is the first frame, the file is created.
+ * The function appends a frame to the file. The whole frame is formatted in memory and
+ * handed to the output buffer with a single write.
  * Coordinates are expected as a flat array [x0,y0,z0, x1,y1,z1, ...]. The output format
  * uses LAMMPS "dump" style with TIMESTEP, NUMBER OF ATOMS, BOX BOUNDS, and ATOMS sections.
  *
@@ -0,0 +1,54 @@
+// numformat.h
+// Fast printf-compatible formatting of the numbers of text trajectory lines (internal to the writers).
+//
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Longest `%f` of a double: sign, 309 integer digits, point, 6 decimals and the terminator
+#define FORMAT_FIXED6_MAX 320
+
+// Write `v` in decimal, same as `%zu`
+static inline char* formatUnsigned(char *out, size_t v) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+// Write `x` as `%f` does (6 decimals), at most FORMAT_FIXED6_MAX - 1 characters. Values whose
+// rounding is ambiguous in double arithmetic, or too large for the fast path, go through snprintf
+// so the output is always identical to `%f`.
+static inline char* formatFixed6(char *out, double x) {
+    const double ax = fabs(x);
+    if (ax < 1e15) {
+        const int64_t ip = (int64_t) ax;
+        const double scaled = (ax - (double) ip) * 1e6;    // ax - ip is exact
+        const double fl = floor(scaled);
+        const double rem = scaled - fl;
+        if (fabs(rem - 0.5) > 1e-6) {
+            int64_t integer = ip;
+            int64_t fraction = (int64_t) fl + (rem > 0.5);
+            if (fraction == 1000000) {
+                integer++;
+                fraction = 0;
+            }
+            if (signbit(x)) *out++ = '-';
+            out = formatUnsigned(out, (size_t) integer);
+            *out++ = '.';
+            for (int d = 5; d >= 0; d--) {
+                out[d] = (char) ('0' + fraction % 10);
+                fraction /= 10;
+            }
+            return out + 6;
+        }
+    }
+    return out + snprintf(out, FORMAT_FIXED6_MAX, "%f", x);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file trjcodec.c
+ * @brief Lossy frame codec described in trjcodec.h
+ */
+#include <math.h>
+#include <string.h>
+
+#include "trjcodec.h"
+
+static inline uint64_t zigzagEncode(int64_t v) {
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t zigzagDecode(uint64_t u) {
+    return (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+}
+
+static inline int bitWidth(uint64_t v) {
+    int bits = 0;
+    while (v) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+size_t trjCodecMaxBytes(size_t n_values) {
+    const size_t n_blocks = (n_values + TRJCODEC_BLOCK - 1) / TRJCODEC_BLOCK;
+    return n_blocks * (1 + TRJCODEC_BLOCK * sizeof(uint64_t));
+}
+
+size_t encodeTrjFrame(const double* values, size_t n_values, double precision,
+                      int64_t* reference, int keyframe, uint8_t* out) {
+    const double inv_precision = 1.0 / precision;
+    uint8_t* o = out;
+    uint64_t residuals[TRJCODEC_BLOCK];
+
+    for (size_t start = 0; start < n_values; start += TRJCODEC_BLOCK) {
+        const size_t len = (n_values - start < TRJCODEC_BLOCK) ? n_values - start : TRJCODEC_BLOCK;
+
+        // Quantise, delta encode and find the widest residual of the block
+        uint64_t all_bits = 0;
+        for (size_t k = 0; k < len; k++) {
+            const double scaled = values[start + k] * inv_precision;
+            if (!(fabs(scaled) < 4.0e18)) {
+                return 0; // NaN, inf, or out of the int64 range
+            }
+            const int64_t q = llround(scaled);
+            const int64_t r = keyframe ? q : q - reference[start + k];
+            reference[start + k] = q;
+            residuals[k] = zigzagEncode(r);
+            all_bits |= residuals[k];
+        }
+        const int bits = bitWidth(all_bits);
+        *o++ = (uint8_t) bits;
+
+        // Pack `bits` bits per residual
+        uint64_t acc = 0;
+        int filled = 0;
+        for (size_t k = 0; k < len && bits > 0; k++) {
+            const uint64_t v = residuals[k];
+            acc |= v << filled;
+            if (filled + bits >= 64) {
+                memcpy(o, &acc, sizeof(acc));
+                o += sizeof(acc);
+                const int consumed = 64 - filled;
+                acc = (consumed < 64) ? v >> consumed : 0;
+                filled = bits - consumed;
+            } else {
+                filled += bits;
+            }
+        }
+        while (filled > 0) {
+            *o++ = (uint8_t) acc;
+            acc >>= 8;
+            filled -= 8;
+        }
+    }
+    return (size_t) (o - out);
+}
+
+int decodeTrjFrame(const uint8_t* in, size_t in_bytes, size_t n_values, double precision,
+                   int64_t* reference, int keyframe, double* values) {
+    const uint8_t* p = in;
+    const uint8_t* end = in + in_bytes;
+
+    for (size_t start = 0; start < n_values; start += TRJCODEC_BLOCK) {
+        const size_t len = (n_values - start < TRJCODEC_BLOCK) ? n_values - start : TRJCODEC_BLOCK;
+        if (p >= end) {
+            return -1;
+        }
+        const int bits = *p++;
+        const size_t packed = (len * (size_t) bits + 7) / 8;
+        if (bits > 64 || (size_t) (end - p) < packed) {
+            return -1;
+        }
+        const uint64_t mask = (bits == 64) ? ~UINT64_C(0) : (UINT64_C(1) << bits) - 1;
+
+        // Unpack reading whole bytes into a 64-bit window
+        uint64_t acc = 0;
+        int available = 0;
+        const uint8_t* q = p;
+        for (size_t k = 0; k < len; k++) {
+            uint64_t u = 0;
+            if (bits > 0) {
+                while (available < bits && available <= 56) {
+                    acc |= (uint64_t) (*q++) << available;
+                    available += 8;
+                }
+                if (available >= bits) {
+                    u = acc & mask;
+                    acc = (bits == 64) ? 0 : acc >> bits;
+                    available -= bits;
+                } else {
+                    // More than 56 bits needed: take what is left and complete with the next byte
+                    const uint8_t next = *q++;
+                    u = (acc | ((uint64_t) next << available)) & mask;
+                    const int from_next = bits - available;
+                    acc = (uint64_t) next >> from_next;
+                    available = 8 - from_next;
+                }
+            }
+            const int64_t r = zigzagDecode(u);
+            const int64_t value = keyframe ? r : reference[start + k] + r;
+            reference[start + k] = value;
+            values[start + k] = (double) value * precision;
+        }
+        p += packed;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+// trjcodec.h
+// Lossy compression of trajectory frames.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file trjcodec.h
+ * @brief Quantisation + delta encoding + bit packing of coordinate frames.
+ *
+ * Each coordinate is quantised to an integer multiple of `precision` (the error is at most
+ * precision/2), the quantised frame is delta encoded against the previous quantised frame
+ * (unless it is a keyframe), residuals are zigzag mapped to unsigned integers and packed in
+ * blocks of `TRJCODEC_BLOCK` values, each block using the bit width of its largest residual.
+ *
+ * Encoded frame: for every block, 1 byte with the bit width followed by the packed bits
+ * (little endian, padded to a whole byte).
+ */
+
+#define TRJCODEC_BLOCK 32
+
+/**
+ * @brief Upper bound of the encoded size of a frame of `n_values` values
+ */
+size_t trjCodecMaxBytes(size_t n_values);
+
+/**
+ * @brief Encode a frame
+ * @param values The values to encode (e.g. 3*n_particles coordinates)
+ * @param n_values Number of values
+ * @param precision Quantisation step
+ * @param reference Quantised previous frame, updated with the quantised current frame.
+ *                  Ignored (but still updated) for keyframes.
+ * @param keyframe If non-zero the frame is encoded without reference to the previous one
+ * @param out Output buffer of at least `trjCodecMaxBytes(n_values)` bytes
+ * @return Number of bytes written, 0 if a value cannot be quantised with this precision
+ */
+size_t encodeTrjFrame(const double* values, size_t n_values, double precision,
+                      int64_t* reference, int keyframe, uint8_t* out);
+
+/**
+ * @brief Decode a frame produced by `encodeTrjFrame`
+ * @param in Encoded frame
+ * @param in_bytes Size of the encoded frame
+ * @param n_values Number of values
+ * @param precision Quantisation step used by the encoder
+ * @param reference Quantised previous frame, updated with the quantised current frame
+ * @param keyframe Must match the value given to the encoder
+ * @param values Where to store the decoded values
+ * @return 0 on success, -1 if the frame is corrupted
+ */
+int decodeTrjFrame(const uint8_t* in, size_t in_bytes, size_t n_values, double precision,
+                   int64_t* reference, int keyframe, double* values);
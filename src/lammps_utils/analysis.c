@@ -1,8 +1,12 @@
 //
 // Created by gu on 27/03/25.
 //
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include <omp.h>
 
 #include "analysis.h"
 #include "parser.h"
@@ -23,42 +27,276 @@ void compute_CoM(const double* frame, const int64_t num_atoms, double* com_coord
     //printf("%lf %lf %lf\n", com_coord[0], com_coord[1], com_coord[2]);
 }
 
+double* computeMoleculeCoMs(const LAMMPSData* data, const double* typeMasses, const int64_t numTypes,
+                            const int wrapped, int64_t** moleculeIds, int64_t* numMolecules, const int num_threads) {
+    /*
+     * Centre of mass of every molecule in every frame, stored as frames x molecules x 3.
+     * The atoms of a molecule are contiguous in `moleculeIndex.members`, so every frame is a
+     * segmented reduction over that array, summed relative to the first atom of each segment
+     * with precomputed weights m_i / M. Wrapped coordinates are first unwrapped bond by bond.
+     */
+    const LAMMPSGroupIndex* index = &data->moleculeIndex;
+    *moleculeIds = NULL;
+    *numMolecules = 0;
+    if (!index->offsets) {
+        fprintf(stderr, "Error: No molecule index, molecule ids were not loaded or are not usable.\n");
+        return NULL;
+    }
+    if (typeMasses && !data->atomTypes) {
+        fprintf(stderr, "Error: Masses by type need the atom types.\n");
+        return NULL;
+    }
+
+    int64_t M = 0;
+    for (int64_t k = 0; k <= index->max_key; k++) {
+        if (index->offsets[k + 1] > index->offsets[k]) M++;
+    }
+    const int64_t N = data->num_atoms;
+    const int64_t T = data->num_timesteps;
+
+    int64_t* molIds = malloc((M > 0 ? M : 1) * sizeof(int64_t));
+    int64_t* segments = malloc((M + 1) * sizeof(int64_t));
+    int64_t* slots = malloc((N > 0 ? N : 1) * sizeof(int64_t));
+    double* weights = malloc((N > 0 ? N : 1) * sizeof(double));
+    double* coms = malloc((T * M > 0 ? 3 * T * M : 1) * sizeof(double));
+    if (!molIds || !segments || !slots || !weights || !coms) {
+        fprintf(stderr, "Error: Memory allocation failed for the centres of mass of %ld molecules.\n", M);
+        free(molIds);
+        free(segments);
+        free(slots);
+        free(weights);
+        free(coms);
+        return NULL;
+    }
+
+    // Compact the index to the molecules that have atoms, with normalised weights
+    int64_t m = 0;
+    int valid = 1;
+    segments[0] = 0;
+    for (int64_t k = 0; k <= index->max_key; k++) {
+        const int64_t first = index->offsets[k];
+        const int64_t last = index->offsets[k + 1];
+        if (last == first) continue;
+
+        double total_mass = 0.;
+        for (int64_t j = first; j < last; j++) {
+            const int64_t slot = index->members[j];
+            double mass = 1.;
+            if (typeMasses) {
+                const int64_t type = data->atomTypes[slot];
+                if (type < 0 || type >= numTypes) {
+                    fprintf(stderr, "Error: No mass for type %ld of atom %ld.\n", type, data->atomIds[slot]);
+                    valid = 0;
+                    break;
+                }
+                mass = typeMasses[type];
+            }
+            slots[j] = slot;
+            weights[j] = mass;
+            total_mass += mass;
+        }
+        if (valid && !(total_mass > 0.)) {
+            fprintf(stderr, "Error: Molecule %ld has total mass %lf, its centre of mass is undefined.\n",
+                    k, total_mass);
+            valid = 0;
+        }
+        if (!valid) break;
+        for (int64_t j = first; j < last; j++) {
+            weights[j] /= total_mass;
+        }
+        molIds[m] = k;
+        segments[++m] = last;
+    }
+    if (!valid) {
+        free(molIds);
+        free(segments);
+        free(slots);
+        free(weights);
+        free(coms);
+        return NULL;
+    }
+
+    // Box lengths for wrapped coordinates; a zero length disables the periodic fold along that axis
+    double L[3], invL[3];
+    for (int d = 0; d < 3; d++) {
+        L[d] = data->box ? data->box[2*d+1] - data->box[2*d] : 0.;
+        invL[d] = L[d] > 0. ? 1. / L[d] : 0.;
+    }
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    for (int64_t t = 0; t < T; t++) {
+        const double* frame = data->coordinates + 3 * t * N;
+        double* frame_coms = coms + 3 * t * M;
+        for (int64_t mol = 0; mol < M; mol++) {
+            const int64_t first = segments[mol];
+            const int64_t last = segments[mol + 1];
+            const double* ref = frame + 3 * slots[first];
+            double cx = 0., cy = 0., cz = 0.;
+            if (!wrapped) {
+                #pragma omp simd reduction(+:cx, cy, cz)
+                for (int64_t j = first; j < last; j++) {
+                    const double* r = frame + 3 * slots[j];
+                    cx += weights[j] * (r[0] - ref[0]);
+                    cy += weights[j] * (r[1] - ref[1]);
+                    cz += weights[j] * (r[2] - ref[2]);
+                }
+            } else {
+                // Offset of each atom from the first one, unwrapped bond by bond
+                double ux = 0., uy = 0., uz = 0.;
+                for (int64_t j = first + 1; j < last; j++) {
+                    const double* r = frame + 3 * slots[j];
+                    const double* prev = frame + 3 * slots[j - 1];
+                    double dx = r[0] - prev[0];
+                    double dy = r[1] - prev[1];
+                    double dz = r[2] - prev[2];
+                    ux += dx - L[0] * nearbyint(dx * invL[0]);
+                    uy += dy - L[1] * nearbyint(dy * invL[1]);
+                    uz += dz - L[2] * nearbyint(dz * invL[2]);
+                    cx += weights[j] * ux;
+                    cy += weights[j] * uy;
+                    cz += weights[j] * uz;
+                }
+            }
+            frame_coms[3*mol]   = ref[0] + cx;
+            frame_coms[3*mol+1] = ref[1] + cy;
+            frame_coms[3*mol+2] = ref[2] + cz;
+        }
+    }
+
+    free(segments);
+    free(slots);
+    free(weights);
+    *moleculeIds = molIds;
+    *numMolecules = M;
+    return coms;
+}
+
+// Copy the trajectory of the atom in `slot` (frame-major stride 3N) into `beadTraj` (T x 3)
+static void copyBeadTrajectory(const LAMMPSData* data, const int64_t slot, double* beadTraj) {
+    const size_t frame_len = 3 * (size_t) data->num_atoms;
+    const double* src = data->coordinates + 3*slot;
+    for (int64_t t = 0; t < data->num_timesteps; t++) {
+        beadTraj[3*t]   = src[t*frame_len];
+        beadTraj[3*t+1] = src[t*frame_len+1];
+        beadTraj[3*t+2] = src[t*frame_len+2];
+    }
+}
+
 double* getBeadTrajectory(const LAMMPSData* data, const int64_t atom_id) {
     /*
      * Return the trajectory of a select bead as a function of time.
      * The array is a linear array.
+     * The atom is looked up once, then its coordinates are copied with a fixed stride.
      */
-    rarray* coordinates_buff   = rarray_init(sizeof(double), 10);
-
-    for (int64_t t = 0; t < data->num_timesteps; t++)
-    {
-        // Frame offset (elapsed timesteps * number of atoms * 3 coordinates)
-        const int64_t f_offset = t * data->num_atoms * 3;
-
-        for (int p = 0; p < data->num_atoms; p++) {
-            const int64_t at_id = data->atomIds[p];
-
-            if(at_id == atom_id) {
-                // atom offset = (already considered atoms) * (3 coordinates)
-                const int64_t a_offset = 3*p;
-                double x_buff = data->coordinates[f_offset+a_offset  ];
-                double y_buff = data->coordinates[f_offset+a_offset+1];
-                double z_buff = data->coordinates[f_offset+a_offset+2];
-                rarray_push(coordinates_buff, &x_buff);
-                rarray_push(coordinates_buff, &y_buff);
-                rarray_push(coordinates_buff, &z_buff);
+    int64_t slot = 0;
+    while (slot < data->num_atoms && data->atomIds[slot] != atom_id) slot++;
+    if (slot == data->num_atoms) {
+        return NULL;
+    }
+
+    double* beadTraj = malloc(3 * (size_t) data->num_timesteps * sizeof(double));
+    if (!beadTraj) {
+        fprintf(stderr, "Error: Memory allocation failed for the trajectory of atom %ld.\n", atom_id);
+        return NULL;
+    }
+    copyBeadTrajectory(data, slot, beadTraj);
+    return beadTraj;
+}
+
+double* getBeadTrajectoryIndexed(const LAMMPSData* data, const DumpIdMap* index, const int64_t atom_id) {
+    const int64_t slot = (atom_id >= 0 && atom_id <= index->max_id) ? index->slot[atom_id] : -1;
+    if (slot < 0) {
+        return NULL;
+    }
+
+    double* beadTraj = malloc(3 * (size_t) data->num_timesteps * sizeof(double));
+    if (!beadTraj) {
+        fprintf(stderr, "Error: Memory allocation failed for the trajectory of atom %ld.\n", atom_id);
+        return NULL;
+    }
+    copyBeadTrajectory(data, slot, beadTraj);
+    return beadTraj;
+}
+
+double* getBeadTrajectories(const LAMMPSData* data, const DumpIdMap* index,
+                            const int64_t* atom_ids, const int64_t num_beads, const int num_threads) {
+    const int64_t T = data->num_timesteps;
+    const size_t frame_len = 3 * (size_t) data->num_atoms;
+
+    const size_t total_len = 3 * (size_t) (num_beads * T);
+    int64_t* slots = malloc((num_beads > 0 ? num_beads : 1) * sizeof(int64_t));
+    double* beadTrajs = malloc((total_len > 0 ? total_len : 1) * sizeof(double));
+    if (!slots || !beadTrajs) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld trajectories.\n", num_beads);
+        free(slots);
+        free(beadTrajs);
+        return NULL;
+    }
+    for (int64_t k = 0; k < num_beads; k++) {
+        const int64_t id = atom_ids[k];
+        slots[k] = (id >= 0 && id <= index->max_id) ? index->slot[id] : -1;
+        if (slots[k] < 0) {
+            fprintf(stderr, "Error: Atom %ld not found.\n", id);
+            free(slots);
+            free(beadTrajs);
+            return NULL;
+        }
+    }
+
+    // Blocks of frames: each frame is read once per block, and every bead gets a contiguous run
+    // of `block` positions instead of a single scattered write per frame
+    const int64_t block = 64;
+    #pragma omp parallel for schedule(static) num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    for (int64_t t0 = 0; t0 < T; t0 += block) {
+        const int64_t t1 = (t0 + block < T) ? t0 + block : T;
+        for (int64_t k = 0; k < num_beads; k++) {
+            const double* src = data->coordinates + 3*slots[k];
+            double* dst = beadTrajs + 3*k*T;
+            for (int64_t t = t0; t < t1; t++) {
+                dst[3*t]   = src[t*frame_len];
+                dst[3*t+1] = src[t*frame_len+1];
+                dst[3*t+2] = src[t*frame_len+2];
             }
         }
     }
-    //[TODO] Understand how struct are passed to functions. I might be using struct* and struct->value and struct.value badly
-    double* beadTraj = (double*) rarray_to_array(coordinates_buff);
-    rarray_free(coordinates_buff);
+    free(slots);
+    return beadTrajs;
+}
 
-    return beadTraj;
+// Number of atoms with one of `keys` in `index`
+static int64_t countGroupMembers(const LAMMPSGroupIndex* index, const int64_t* keys, const int64_t num_keys) {
+    int64_t count = 0;
+    for (int64_t k = 0; k < num_keys; k++) {
+        if (keys[k] >= 0 && keys[k] <= index->max_key) {
+            count += index->offsets[keys[k] + 1] - index->offsets[keys[k]];
+        }
+    }
+    return count;
 }
 
+// Ids of the atoms with one of `keys`, key by key, each key in the order of `data->atomIds`
+static int64_t* gatherGroupMembers(const LAMMPSData* data, const LAMMPSGroupIndex* index,
+                                   const int64_t* keys, const int64_t num_keys, const int64_t count) {
+    int64_t* sel_atIds = malloc((count > 0 ? count : 1) * sizeof(int64_t));
+    if (!sel_atIds) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld selected atoms.\n", count);
+        return NULL;
+    }
+    int64_t n = 0;
+    for (int64_t k = 0; k < num_keys; k++) {
+        if (keys[k] < 0 || keys[k] > index->max_key) continue;
+        for (int64_t j = index->offsets[keys[k]]; j < index->offsets[keys[k] + 1]; j++) {
+            sel_atIds[n++] = data->atomIds[index->members[j]];
+        }
+    }
+    return sel_atIds;
+}
 
 int64_t* getAtomsFromMoleculeList(const LAMMPSData* data, const int64_t* molecule_ids, const int64_t numMolecules, int64_t* numOfSelectedAtoms) {
+    if (data->moleculeIndex.offsets) {
+        *numOfSelectedAtoms = countGroupMembers(&data->moleculeIndex, molecule_ids, numMolecules);
+        return gatherGroupMembers(data, &data->moleculeIndex, molecule_ids, numMolecules, *numOfSelectedAtoms);
+    }
 
     *numOfSelectedAtoms = 0;
     // We espect at least 1 atom per molecule
@@ -87,7 +325,16 @@ int64_t* getAtomsFromMoleculeList(const LAMMPSData* data, const int64_t* molecul
 int64_t* getAtomsInMolecule(const LAMMPSData* data, const int64_t molecule_id, int64_t* numOfSelectedAtoms) {
     /*
      * Return the atom ids corresponding to a given molecule.
+     * With the molecule index this is O(atoms in the molecule), otherwise all the atoms are scanned.
      */
+    if (data->moleculeIndex.offsets) {
+        *numOfSelectedAtoms = countGroupMembers(&data->moleculeIndex, &molecule_id, 1);
+        if (*numOfSelectedAtoms == 0) {
+            return NULL;
+        }
+        return gatherGroupMembers(data, &data->moleculeIndex, &molecule_id, 1, *numOfSelectedAtoms);
+    }
+
     rarray* atoms_buff   = rarray_init(sizeof(int64_t), 10);
     *numOfSelectedAtoms = 0;
 
@@ -113,6 +360,14 @@ int64_t* getAtomsFromType(const LAMMPSData* data, const int64_t* a_types, const
     /*
      * Return the atom ids corresponding to a given molecule.
      */
+    if (data->typeIndex.offsets) {
+        *numOfSelectedAtoms = countGroupMembers(&data->typeIndex, a_types, numATypes);
+        if (*numOfSelectedAtoms == 0) {
+            return NULL;
+        }
+        return gatherGroupMembers(data, &data->typeIndex, a_types, numATypes, *numOfSelectedAtoms);
+    }
+
     rarray* atoms_buff   = rarray_init(sizeof(int64_t), 10);
     *numOfSelectedAtoms = 0;
 
@@ -9,7 +9,42 @@
 #include "parser.h"
 
 void compute_CoM(const double* frame, const int64_t num_atoms, double* com_coord);
+
+/**
+ * @brief Mass-weighted centre of mass of every molecule in every frame, in parallel over frames
+ * @param typeMasses Mass of each atom type (indexed by type), NULL for unit masses
+ * @param numTypes Number of entries in `typeMasses`
+ * @param wrapped Non-zero if the coordinates are wrapped into the box (`x y z` columns), 0 if they are
+ *                unwrapped (`xu yu zu`, the default of the loaders)
+ * @param moleculeIds Set to an array to free with the id of each molecule, in increasing order
+ * @param numMolecules Set to the number of molecules
+ * @return Array to free with num_timesteps x numMolecules x 3 centres, NULL on failure
+ *         (e.g. a molecule whose total mass is not positive).
+ *         Unwrapped coordinates are used as they are. Wrapped molecules are rebuilt bond by bond:
+ *         each atom is placed at the minimum image of the previous one (in `data->atomIds` order), which holds
+ *         as long as consecutive atoms are closer than half the box
+ */
+double* computeMoleculeCoMs(const LAMMPSData* data, const double* typeMasses, const int64_t numTypes,
+                            const int wrapped, int64_t** moleculeIds, int64_t* numMolecules, const int num_threads);
 double* getBeadTrajectory(const LAMMPSData* data, const int64_t atom_id);
+
+/**
+ * @brief Trajectory (T x 3) of one atom in O(T), through an id index
+ * @param index Built once with `buildDumpIdMap(data->atomIds, data->num_atoms, &index)`
+ * @return Array to free, NULL if the atom is not in `data`
+ */
+double* getBeadTrajectoryIndexed(const LAMMPSData* data, const DumpIdMap* index, const int64_t atom_id);
+
+/**
+ * @brief Trajectories of `num_beads` atoms gathered in one sweep over the frames
+ * @param index Built once with `buildDumpIdMap(data->atomIds, data->num_atoms, &index)`
+ * @param num_threads Number of OpenMP threads (<= 0 for the OpenMP default)
+ * @return Array to free with the T x 3 trajectory of each atom one after the other
+ *         (bead k starts at 3*k*num_timesteps), NULL on failure
+ * @note On an atom-major transpose the same T x 3 rows are `atomMajorTrajectory(am, slot)`, without a copy
+ */
+double* getBeadTrajectories(const LAMMPSData* data, const DumpIdMap* index,
+                            const int64_t* atom_ids, const int64_t num_beads, const int num_threads);
 int64_t* getAtomsFromMoleculeList(const LAMMPSData* data, const int64_t* molecule_ids, const int64_t numMolecules, int64_t* numOfSelectedAtoms);
 int64_t* getAtomsInMolecule(const LAMMPSData* data, const int64_t molecule_id, int64_t* numOfSelectedAtoms);
 int64_t* getAtomsFromType(const LAMMPSData* data, const int64_t* a_types, const int64_t numATypes, int64_t* numOfSelectedAtoms);
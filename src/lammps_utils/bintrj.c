@@ -0,0 +1,264 @@
+// bintrj.c
+// Reader of the binary trajectory format written by lammpsbinIO, and text dump converter.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "lammpsbinIO.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "trjcodec.h"
+#include "trjstream.h"
+
+// Decode every frame of a compressed trajectory. Keyframes start independent segments,
+// which are decoded in parallel.
+static int decodeCompressedFrames(const char* data, const LammpsBinHeader* header, const int64_t* offsets,
+                                  double* coordinates) {
+    const int64_t num_frames = header->n_frames;
+    const size_t n = 3 * (size_t) header->n_atoms;
+    if (num_frames == 0) {
+        return 0;
+    }
+    int64_t interval = (header->keyframe_interval > 0) ? header->keyframe_interval : num_frames;
+    if (interval < 1) interval = 1;
+    const int64_t num_segments = (num_frames + interval - 1) / interval;
+
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t s = 0; s < num_segments; s++) {
+        int64_t* reference = malloc(n * sizeof(int64_t));
+        if (!reference) {
+            #pragma omp atomic write
+            failed = 1;
+            continue;
+        }
+        const int64_t first = s * interval;
+        const int64_t last  = (first + interval < num_frames) ? first + interval : num_frames;
+        for (int64_t f = first; f < last; f++) {
+            const int64_t end = (f + 1 < num_frames) ? offsets[f+1] : header->trailer_offset;
+            if (decodeTrjFrame((const uint8_t*) data + offsets[f], (size_t) (end - offsets[f]), n, header->precision,
+                               reference, f == first, coordinates + f * n) != 0) {
+                #pragma omp atomic write
+                failed = 1;
+                break;
+            }
+        }
+        free(reference);
+    }
+    return failed ? -1 : 0;
+}
+
+int loadLAMMPSBinary(const char* filename, LAMMPSData* data) {
+    memset(data, 0, sizeof(*data));
+
+    MappedFile* mf = malloc(sizeof(MappedFile));
+    if (!mf) {
+        fprintf(stderr, "Error: Memory allocation failed in loadLAMMPSBinary.\n");
+        return -1;
+    }
+    if (openMappedFileCopyOnWrite(mf, filename) != 0) {
+        free(mf);
+        return -1;
+    }
+
+    LammpsBinHeader header;
+    int valid = mf->size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, mf->data, sizeof(header));
+        valid = memcmp(header.magic, LAMMPSBIN_MAGIC, sizeof(header.magic)) == 0
+             && header.version == LAMMPSBIN_VERSION
+             && header.n_atoms >= 0 && header.n_frames >= 0;
+    }
+
+    const int single_precision = valid && (header.flags & LAMMPSBIN_FLOAT32);
+    const int compressed = valid && (header.flags & LAMMPSBIN_COMPRESSED);
+    const size_t n = valid ? 3 * (size_t) header.n_atoms : 0;
+    const size_t frame_bytes = n * (single_precision ? sizeof(float) : sizeof(double));
+    int64_t* offsets = NULL;
+    if (valid) {
+        // Timestep and box of each frame, plus the block offset for compressed files
+        const size_t trailer_bytes = (size_t) header.n_frames * (compressed ? 8 : 7) * sizeof(int64_t);
+        valid = header.coordinates_offset >= (int64_t) (sizeof(header) + n * sizeof(int64_t))
+             && header.trailer_offset >= header.coordinates_offset
+             && (compressed || header.trailer_offset == header.coordinates_offset + (int64_t) (header.n_frames * frame_bytes))
+             && (size_t) header.trailer_offset + trailer_bytes <= mf->size;
+    }
+    if (valid && compressed) {
+        // The trailer follows variable size blocks, so it is not aligned: copy the offsets out
+        offsets = malloc((header.n_frames > 0 ? header.n_frames : 1) * sizeof(int64_t));
+        if (!offsets) {
+            fprintf(stderr, "Error: Memory allocation failed in loadLAMMPSBinary.\n");
+            closeMappedFile(mf);
+            free(mf);
+            return -1;
+        }
+        memcpy(offsets, mf->data + header.trailer_offset + header.n_frames * 7 * sizeof(int64_t),
+               header.n_frames * sizeof(int64_t));
+        for (int64_t f = 0; valid && f < header.n_frames; f++) {
+            const int64_t next = (f + 1 < header.n_frames) ? offsets[f+1] : header.trailer_offset;
+            valid = offsets[f] >= header.coordinates_offset && offsets[f] <= next;
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Error: %s is not a complete binary trajectory.\n", filename);
+        free(offsets);
+        closeMappedFile(mf);
+        free(mf);
+        return -1;
+    }
+
+    const int64_t num_atoms  = header.n_atoms;
+    const int64_t num_frames = header.n_frames;
+    const char* topology     = mf->data + sizeof(header);
+    const char* trailer      = mf->data + header.trailer_offset;
+
+    data->num_atoms     = num_atoms;
+    data->num_timesteps = num_frames;
+    data->atomIds       = malloc(num_atoms * sizeof(int64_t));
+    data->moleculeIds   = malloc(num_atoms * sizeof(int64_t));
+    data->atomTypes     = malloc(num_atoms * sizeof(int64_t));
+    data->timesteps     = malloc(num_frames * sizeof(int64_t));
+    data->box           = calloc(6, sizeof(double));
+    if (!data->atomIds || !data->moleculeIds || !data->atomTypes || !data->box || (num_frames > 0 && !data->timesteps)) {
+        fprintf(stderr, "Error: Memory allocation failed in loadLAMMPSBinary.\n");
+        free(offsets);
+        closeMappedFile(mf);
+        free(mf);
+        return -1;
+    }
+    memcpy(data->atomIds,     topology,                                    num_atoms * sizeof(int64_t));
+    memcpy(data->moleculeIds, topology + num_atoms * sizeof(int64_t),      num_atoms * sizeof(int64_t));
+    memcpy(data->atomTypes,   topology + 2 * num_atoms * sizeof(int64_t),  num_atoms * sizeof(int64_t));
+    memcpy(data->timesteps,   trailer,                                     num_frames * sizeof(int64_t));
+    if (num_frames > 0) {
+        memcpy(data->box, trailer + num_frames * sizeof(int64_t), 6 * sizeof(double));
+    }
+
+    if (compressed) {
+        data->coordinates = malloc(num_frames * n * sizeof(double));
+        if (!data->coordinates && num_frames > 0) {
+            fprintf(stderr, "Error: Memory allocation failed in loadLAMMPSBinary.\n");
+            free(offsets);
+            closeMappedFile(mf);
+            free(mf);
+            return -1;
+        }
+        const int status = decodeCompressedFrames(mf->data, &header, offsets, data->coordinates);
+        free(offsets);
+        closeMappedFile(mf);
+        free(mf);
+        if (status != 0) {
+            fprintf(stderr, "Error: Corrupted compressed frames in %s\n", filename);
+            return -1;
+        }
+    } else if (!single_precision) {
+        // Zero copy: the coordinate blocks already form a frame-major T x N x 3 array
+        data->coordinates = (double*) (mf->data + header.coordinates_offset);
+        data->mapping = mf;
+    } else {
+        data->coordinates = malloc(num_frames * n * sizeof(double));
+        if (!data->coordinates && num_frames > 0) {
+            fprintf(stderr, "Error: Memory allocation failed in loadLAMMPSBinary.\n");
+            closeMappedFile(mf);
+            free(mf);
+            return -1;
+        }
+        const float* stored = (const float*) (mf->data + header.coordinates_offset);
+        for (size_t i = 0; i < (size_t) num_frames * n; i++) {
+            data->coordinates[i] = (double) stored[i];
+        }
+        closeMappedFile(mf);
+        free(mf);
+    }
+
+    if (indexLAMMPSData(data) != 0) {
+        return -1;
+    }
+
+    if (data->num_timesteps > 1) {
+        data->deltaTimestep = data->timesteps[1] - data->timesteps[0];
+    } else {
+        fprintf(stderr, "Error: less than 2 timesteps found.\n");
+        data->deltaTimestep = 0;
+    }
+    return 0;
+}
+
+// Stream the dump into a binary trajectory, compressed when `precision` > 0
+static int convertLAMMPSDump(const char* dump_filename, const char* binary_filename, int single_precision,
+                             double precision, size_t keyframe_interval) {
+    LAMMPSStream* stream = openLAMMPSStream(dump_filename);
+    if (!stream) {
+        return -1;
+    }
+
+    LAMMPSFrame frame;
+    initLAMMPSFrame(&frame);
+    if (readLAMMPSFrameHeader(stream, &frame) != 1) {
+        fprintf(stderr, "Error: No frames found in %s\n", dump_filename);
+        closeLAMMPSStream(stream);
+        return -1;
+    }
+
+    const int64_t num_atoms = frame.num_atoms;
+    double* coordinates  = malloc(3 * num_atoms * sizeof(double));
+    int64_t* atomIds     = malloc(num_atoms * sizeof(int64_t));
+    int64_t* moleculeIds = malloc(num_atoms * sizeof(int64_t));
+    int64_t* atomTypes   = malloc(num_atoms * sizeof(int64_t));
+
+    LammpsBinFile lb;
+    DumpIdMap order = {-1, NULL, 0};   // Later frames are stored in the atom order of the first one
+    int status = -1;
+    if (!coordinates || !atomIds || !moleculeIds || !atomTypes) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld atoms.\n", num_atoms);
+    } else if (readLAMMPSFrameAtoms(stream, num_atoms, coordinates, atomIds, moleculeIds, atomTypes) == 0
+               && buildDumpIdMap(atomIds, num_atoms, &order) == 0
+               && (precision > 0.0
+                   ? initLammpsBinDataCompressed(&lb, binary_filename, (size_t) num_atoms, 0.0, precision, keyframe_interval)
+                   : initLammpsBinData(&lb, binary_filename, (size_t) num_atoms, 0.0, single_precision)) == 0) {
+        status = setLammpsBinTopology(&lb, atomIds, moleculeIds, atomTypes);
+        if (status == 0) {
+            status = writeLammpsBinFrameAt(&lb, frame.timestep, frame.box, coordinates);
+        }
+
+        int read = 0;
+        while (status == 0 && (read = readLAMMPSFrameHeader(stream, &frame)) == 1) {
+            if (frame.num_atoms != num_atoms) {
+                fprintf(stderr, "Error: Frame at timestep %ld has %ld atoms instead of %ld.\n",
+                        frame.timestep, frame.num_atoms, num_atoms);
+                status = -1;
+                break;
+            }
+            status = readLAMMPSFrameAtomsById(stream, num_atoms, &order, coordinates);
+            if (status == 0) {
+                status = writeLammpsBinFrameAt(&lb, frame.timestep, frame.box, coordinates);
+            }
+        }
+        if (status == 0 && read < 0) {
+            status = -1;
+        }
+        if (closeLammpsBinData(&lb) != 0) {
+            status = -1;
+        }
+        freeLammpsBinData(&lb);
+    }
+
+    freeDumpIdMap(&order);
+    free(coordinates);
+    free(atomIds);
+    free(moleculeIds);
+    free(atomTypes);
+    closeLAMMPSStream(stream);
+    return status;
+}
+
+int convertLAMMPSDumpToBinary(const char* dump_filename, const char* binary_filename, int single_precision) {
+    return convertLAMMPSDump(dump_filename, binary_filename, single_precision, 0.0, 0);
+}
+
+int convertLAMMPSDumpToCompressed(const char* dump_filename, const char* binary_filename,
+                                  double precision, size_t keyframe_interval) {
+    return convertLAMMPSDump(dump_filename, binary_filename, 0, precision, keyframe_interval);
+}
@@ -0,0 +1,409 @@
+// dumpframe.c
+//
+#include <stdio.h>
+#include <string.h>
+
+#include "dumpframe.h"
+#include "dumpscan.h"
+#include "rarray.h"
+
+// Skip any whitespace, newlines included
+static const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && *p <= ' ') p++;
+    return p;
+}
+
+const char* parseDumpFrameHeader(const char* p, const char* end, DumpFrameHeader* hdr) {
+    int has_timestep = 0;
+    int has_atoms = 0;
+
+    hdr->num_atoms = -1;
+    for (int d = 0; d < 6; d++) hdr->box[d] = 0.;
+
+    while (p < end) {
+        if (!dumpHasPrefix(p, end, "ITEM:", 5)) {
+            // Blank lines, or the payload of an ITEM we do not know about
+            p = dumpNextLine(p, end);
+            continue;
+        }
+
+        if (dumpHasPrefix(p, end, "ITEM: TIMESTEP", 14)) {
+            if (has_timestep) {
+                return NULL; // A new frame started before ITEM: ATOMS
+            }
+            p = dumpNextLine(p, end);
+            hdr->timestep = dumpScanInt64(&p, end);
+            p = dumpNextLine(p, end);
+            has_timestep = 1;
+        }
+        else if (dumpHasPrefix(p, end, "ITEM: NUMBER OF ATOMS", 21)) {
+            p = dumpNextLine(p, end);
+            hdr->num_atoms = dumpScanInt64(&p, end);
+            p = dumpNextLine(p, end);
+        }
+        else if (dumpHasPrefix(p, end, "ITEM: BOX BOUNDS", 16)) {
+            p = dumpNextLine(p, end);
+            for (int d = 0; d < 3 && p < end; d++) {
+                const char* q = p;
+                hdr->box[2*d]   = dumpScanDouble(&q, end);
+                hdr->box[2*d+1] = dumpScanDouble(&q, end);
+                p = dumpNextLine(p, end);
+            }
+        }
+        else if (dumpHasPrefix(p, end, "ITEM: ATOMS", 11)) {
+            hdr->columns = dumpSkipBlanks(p + 11, end);
+            p = dumpNextLine(p, end);
+            hdr->columns_end = p;
+            while (hdr->columns_end > hdr->columns && hdr->columns_end[-1] <= ' ') hdr->columns_end--;
+            has_atoms = 1;
+            break;
+        }
+        else {
+            p = dumpNextLine(p, end);
+        }
+    }
+
+    if (!has_timestep || !has_atoms || hdr->num_atoms < 0) {
+        return NULL;
+    }
+    return p;
+}
+
+DumpField dumpFieldFromName(const char* name, size_t len) {
+    static const struct { const char* name; DumpField field; } known[] = {
+        {"id", DUMP_FIELD_ID}, {"mol", DUMP_FIELD_MOL}, {"type", DUMP_FIELD_TYPE},
+        {"x", DUMP_FIELD_X}, {"xu", DUMP_FIELD_X}, {"xs", DUMP_FIELD_X}, {"xsu", DUMP_FIELD_X},
+        {"y", DUMP_FIELD_Y}, {"yu", DUMP_FIELD_Y}, {"ys", DUMP_FIELD_Y}, {"ysu", DUMP_FIELD_Y},
+        {"z", DUMP_FIELD_Z}, {"zu", DUMP_FIELD_Z}, {"zs", DUMP_FIELD_Z}, {"zsu", DUMP_FIELD_Z},
+    };
+    for (size_t k = 0; k < sizeof(known) / sizeof(known[0]); k++) {
+        if (strlen(known[k].name) == len && memcmp(known[k].name, name, len) == 0) {
+            return known[k].field;
+        }
+    }
+    return DUMP_FIELD_PROPERTY;
+}
+
+int buildDumpColumnMap(const char* columns, const char* columns_end, const char* requested, DumpColumnMap* map) {
+    if (!requested) {
+        requested = "id mol type xu yu zu";
+    }
+
+    // Where each column name starts
+    const char* names[DUMP_MAX_COLUMNS];
+    size_t lengths[DUMP_MAX_COLUMNS];
+    int num_columns = 0;
+    const char* p = skipSpaces(columns, columns_end);
+    while (p < columns_end) {
+        const char* name_end = dumpSkipToken(p, columns_end);
+        if (num_columns == DUMP_MAX_COLUMNS) {
+            fprintf(stderr, "Error: More than %d atom columns.\n", DUMP_MAX_COLUMNS);
+            return -1;
+        }
+        names[num_columns] = p;
+        lengths[num_columns] = (size_t) (name_end - p);
+        num_columns++;
+        p = skipSpaces(name_end, columns_end);
+    }
+
+    map->num_columns = num_columns;
+    map->num_used = 0;
+    map->id_column = -1;
+    for (int c = 0; c < num_columns && map->id_column < 0; c++) {
+        if (lengths[c] == 2 && memcmp(names[c], "id", 2) == 0) map->id_column = c;
+    }
+    map->num_properties = 0;
+    for (int f = 0; f < DUMP_FIELD_PROPERTY; f++) map->has_field[f] = 0;
+    for (int c = 0; c < DUMP_MAX_COLUMNS; c++) {
+        map->field[c] = DUMP_FIELD_SKIP;
+        map->property[c] = -1;
+    }
+
+    const char* r = requested;
+    const char* r_end = requested + strlen(requested);
+    while ((r = skipSpaces(r, r_end)) < r_end) {
+        const char* name_end = dumpSkipToken(r, r_end);
+        const size_t len = (size_t) (name_end - r);
+
+        int c = 0;
+        while (c < num_columns && (lengths[c] != len || memcmp(names[c], r, len) != 0)) c++;
+        if (c == num_columns) {
+            fprintf(stderr, "Error: Column %.*s not found in ITEM: ATOMS %.*s\n",
+                    (int) len, r, (int) (columns_end - columns), columns);
+            return -1;
+        }
+
+        const DumpField field = dumpFieldFromName(r, len);
+        if (map->field[c] != DUMP_FIELD_SKIP || (field != DUMP_FIELD_PROPERTY && map->has_field[field])) {
+            fprintf(stderr, "Error: Column %.*s requested twice.\n", (int) len, r);
+            return -1;
+        }
+        map->field[c] = (int8_t) field;
+        if (field == DUMP_FIELD_PROPERTY) {
+            map->property[c] = (int16_t) map->num_properties++;
+        } else {
+            map->has_field[field] = 1;
+        }
+        if (c + 1 > map->num_used) map->num_used = c + 1;
+        r = name_end;
+    }
+
+    const int num_positions = map->has_field[DUMP_FIELD_X] + map->has_field[DUMP_FIELD_Y] + map->has_field[DUMP_FIELD_Z];
+    if (num_positions != 0 && num_positions != 3) {
+        fprintf(stderr, "Error: Positions must be requested as x, y and z together.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Convert the columns of one atom line selected by `map`, starting at column `first_column`
+// (where `p` points); returns the start of the next line
+static inline const char* parseAtomLine(const char* p, const char* end, const DumpColumnMap* map, int first_column,
+                                        int64_t ints[3], double xyz[3], double* props) {
+    const int num_used = map->num_used;
+    for (int c = first_column; c < num_used; c++) {
+        const int field = map->field[c];
+        switch (field) {
+            case DUMP_FIELD_SKIP:
+                p = dumpSkipToken(p, end);
+                break;
+            case DUMP_FIELD_ID:
+            case DUMP_FIELD_MOL:
+            case DUMP_FIELD_TYPE:
+                ints[field] = dumpScanInt64(&p, end);
+                break;
+            case DUMP_FIELD_X:
+            case DUMP_FIELD_Y:
+            case DUMP_FIELD_Z:
+                xyz[field - DUMP_FIELD_X] = dumpScanDouble(&p, end);
+                break;
+            default: {
+                const double v = dumpScanDouble(&p, end);
+                if (props) props[map->property[c]] = v;
+            }
+        }
+    }
+    return dumpNextLine(p, end);
+}
+
+const char* parseDumpAtoms(const char* p, const char* end, int64_t num_atoms, const DumpColumnMap* map,
+                           double* coordinates, int64_t* atomIds, int64_t* moleculeIds, int64_t* atomTypes,
+                           double* properties) {
+    const int num_properties = map->num_properties;
+
+    // Plain `id mol type x y z` prefix: no per-column dispatch
+    int canonical = (map->num_used == 6);
+    for (int c = 0; canonical && c < 6; c++) canonical = (map->field[c] == c);
+    if (canonical) {
+        for (int64_t i = 0; i < num_atoms; i++) {
+            if (p >= end) {
+                return NULL;
+            }
+            const int64_t atomId   = dumpScanInt64(&p, end);
+            const int64_t molId    = dumpScanInt64(&p, end);
+            const int64_t atomType = dumpScanInt64(&p, end);
+            if (atomIds)     atomIds[i]     = atomId;
+            if (moleculeIds) moleculeIds[i] = molId;
+            if (atomTypes)   atomTypes[i]   = atomType;
+
+            if (coordinates) {
+                coordinates[3*i]   = dumpScanDouble(&p, end);
+                coordinates[3*i+1] = dumpScanDouble(&p, end);
+                coordinates[3*i+2] = dumpScanDouble(&p, end);
+            }
+            p = dumpNextLine(p, end);
+        }
+        return p;
+    }
+
+    for (int64_t i = 0; i < num_atoms; i++) {
+        if (p >= end) {
+            return NULL;
+        }
+        int64_t ints[3] = {0, 0, 0};
+        double xyz[3] = {0., 0., 0.};
+        p = parseAtomLine(p, end, map, 0, ints, xyz, properties ? properties + i * num_properties : NULL);
+
+        if (atomIds)     atomIds[i]     = ints[DUMP_FIELD_ID];
+        if (moleculeIds) moleculeIds[i] = ints[DUMP_FIELD_MOL];
+        if (atomTypes)   atomTypes[i]   = ints[DUMP_FIELD_TYPE];
+        if (coordinates) {
+            coordinates[3*i]   = xyz[0];
+            coordinates[3*i+1] = xyz[1];
+            coordinates[3*i+2] = xyz[2];
+        }
+    }
+    return p;
+}
+
+int buildDumpIdMap(const int64_t* ids, int64_t num_ids, DumpIdMap* map) {
+    map->max_id = -1;
+    map->slot = NULL;
+    map->num_slots = num_ids;
+    for (int64_t k = 0; k < num_ids; k++) {
+        if (ids[k] < 0) {
+            fprintf(stderr, "Error: Negative atom id %ld.\n", ids[k]);
+            return -1;
+        }
+        if (ids[k] > map->max_id) map->max_id = ids[k];
+    }
+
+    map->slot = malloc((size_t) (map->max_id + 1) * sizeof(int64_t));
+    if (!map->slot) {
+        fprintf(stderr, "Error: Memory allocation failed for the ids up to %ld.\n", map->max_id);
+        return -1;
+    }
+    for (int64_t id = 0; id <= map->max_id; id++) map->slot[id] = -1;
+    for (int64_t k = 0; k < num_ids; k++) {
+        if (map->slot[ids[k]] >= 0) {
+            fprintf(stderr, "Error: Atom id %ld appears twice.\n", ids[k]);
+            freeDumpIdMap(map);
+            return -1;
+        }
+        map->slot[ids[k]] = k;
+    }
+    return 0;
+}
+
+void freeDumpIdMap(DumpIdMap* map) {
+    free(map->slot);
+    map->slot = NULL;
+    map->max_id = -1;
+    map->num_slots = 0;
+}
+
+int initDumpSlotStamps(const DumpIdMap* ids, DumpSlotStamps* stamps) {
+    stamps->generation = 0;
+    stamps->stamp = malloc((ids->num_slots > 0 ? ids->num_slots : 1) * sizeof(int64_t));
+    if (!stamps->stamp) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld atom slots.\n", ids->num_slots);
+        return -1;
+    }
+    for (int64_t k = 0; k < ids->num_slots; k++) stamps->stamp[k] = -1;
+    return 0;
+}
+
+void freeDumpSlotStamps(DumpSlotStamps* stamps) {
+    free(stamps->stamp);
+    stamps->stamp = NULL;
+}
+
+const char* parseDumpAtomsById(const char* p, const char* end, int64_t num_atoms, const DumpColumnMap* map,
+                               const DumpIdMap* ids, DumpSlotStamps* stamps, double* coordinates,
+                               int64_t* moleculeIds, int64_t* atomTypes, double* properties, int64_t* num_found) {
+    const int id_column = map->id_column;
+    const int num_properties = map->num_properties;
+    *num_found = 0;
+    if (id_column < 0) {
+        fprintf(stderr, "Error: The dump has no id column.\n");
+        return NULL;
+    }
+
+    // Usually nothing before the id is requested, and the line is converted from the id onwards
+    int resume_after_id = 1;
+    for (int c = 0; c < id_column; c++) {
+        if (map->field[c] != DUMP_FIELD_SKIP) resume_after_id = 0;
+    }
+    int canonical = (map->num_used == 6);
+    for (int c = 0; canonical && c < 6; c++) canonical = (map->field[c] == c);
+
+    for (int64_t i = 0; i < num_atoms; i++) {
+        if (p >= end) {
+            return NULL;
+        }
+        // Only the id is converted before deciding whether the line is needed
+        const char* q = p;
+        for (int c = 0; c < id_column; c++) q = dumpSkipToken(q, end);
+        const int64_t id = dumpScanInt64(&q, end);
+        const int64_t k = (id >= 0 && id <= ids->max_id) ? ids->slot[id] : -1;
+        if (k < 0) {
+            p = dumpNextLine(q, end);
+            continue;
+        }
+        if (stamps->stamp[k] == stamps->generation) {
+            fprintf(stderr, "Error: Atom id %ld appears twice in the same frame.\n", id);
+            return NULL;
+        }
+        stamps->stamp[k] = stamps->generation;
+
+        int64_t ints[3] = {id, 0, 0};
+        double xyz[3] = {0., 0., 0.};
+        if (canonical) {
+            ints[DUMP_FIELD_MOL]  = dumpScanInt64(&q, end);
+            ints[DUMP_FIELD_TYPE] = dumpScanInt64(&q, end);
+            xyz[0] = dumpScanDouble(&q, end);
+            xyz[1] = dumpScanDouble(&q, end);
+            xyz[2] = dumpScanDouble(&q, end);
+            p = dumpNextLine(q, end);
+        } else {
+            double* props = properties ? properties + k * num_properties : NULL;
+            p = resume_after_id ? parseAtomLine(q, end, map, id_column + 1, ints, xyz, props)
+                                : parseAtomLine(p, end, map, 0, ints, xyz, props);
+        }
+
+        if (moleculeIds) moleculeIds[k] = ints[DUMP_FIELD_MOL];
+        if (atomTypes)   atomTypes[k]   = ints[DUMP_FIELD_TYPE];
+        if (coordinates) {
+            coordinates[3*k]   = xyz[0];
+            coordinates[3*k+1] = xyz[1];
+            coordinates[3*k+2] = xyz[2];
+        }
+        (*num_found)++;
+    }
+    return p;
+}
+
+int scanDumpFrameOffsets(const char* data, size_t size, DumpFrameOffsets* fo) {
+    const char* p   = data;
+    const char* end = data + size;
+    DumpFrameHeader hdr;
+
+    rarray* offsets_buf   = rarray_init(sizeof(int64_t), 1024);
+    rarray* timesteps_buf = rarray_init(sizeof(int64_t), 1024);
+    rarray* num_atoms_buf = rarray_init(sizeof(int64_t), 1024);
+
+    const char* atoms;
+    while ((atoms = parseDumpFrameHeader(p, end, &hdr)) != NULL) {
+        // Skip the atom lines, making sure that the frame is complete
+        const char* next = atoms;
+        int64_t lines = 0;
+        while (lines < hdr.num_atoms && next < end) {
+            next = dumpNextLine(next, end);
+            lines++;
+        }
+        if (lines < hdr.num_atoms) {
+            break;
+        }
+
+        int64_t offset = (int64_t) (p - data);
+        rarray_push(offsets_buf, &offset);
+        rarray_push(timesteps_buf, &hdr.timestep);
+        rarray_push(num_atoms_buf, &hdr.num_atoms);
+        p = next;
+    }
+
+    fo->num_frames = (int64_t) rarray_size(offsets_buf);
+    fo->offsets    = (int64_t*) rarray_to_array(offsets_buf);
+    fo->timesteps  = (int64_t*) rarray_to_array(timesteps_buf);
+    fo->num_atoms  = (int64_t*) rarray_to_array(num_atoms_buf);
+    rarray_free(offsets_buf);
+    rarray_free(timesteps_buf);
+    rarray_free(num_atoms_buf);
+
+    if (!fo->offsets || !fo->timesteps || !fo->num_atoms) {
+        fprintf(stderr, "Error: Memory allocation failed in scanDumpFrameOffsets.\n");
+        freeDumpFrameOffsets(fo);
+        return -1;
+    }
+    return 0;
+}
+
+void freeDumpFrameOffsets(DumpFrameOffsets* fo) {
+    free(fo->offsets);
+    free(fo->timesteps);
+    free(fo->num_atoms);
+    fo->offsets = NULL;
+    fo->timesteps = NULL;
+    fo->num_atoms = NULL;
+    fo->num_frames = 0;
+}
@@ -0,0 +1,184 @@
+// dumpframe.h
+// Frame level parsing of a LAMMPS dump kept in memory.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct DumpFrameHeader
+ * @brief The ITEM sections that precede the atom lines of a frame
+ * @param timestep Value of `ITEM: TIMESTEP`
+ * @param num_atoms Value of `ITEM: NUMBER OF ATOMS`
+ * @param box Box bounds as {xlo, xhi, ylo, yhi, zlo, zhi}
+ * @param columns Column list of the `ITEM: ATOMS` line (not NUL terminated)
+ * @param columns_end End of the column list
+ */
+typedef struct DumpFrameHeader {
+    int64_t timestep;
+    int64_t num_atoms;
+    double box[6];
+    const char* columns;
+    const char* columns_end;
+} DumpFrameHeader;
+
+/**
+ * @brief Parse the header of the frame starting at `p` (blank lines are skipped)
+ * @return Pointer to the first atom line, NULL if no complete header is found
+ */
+const char* parseDumpFrameHeader(const char* p, const char* end, DumpFrameHeader* hdr);
+
+#define DUMP_MAX_COLUMNS 64   ///< Maximum number of columns of an ATOMS line
+
+/**
+ * @brief What a column of the ATOMS line is loaded into
+ */
+typedef enum DumpField {
+    DUMP_FIELD_SKIP = -1,   ///< Not requested: the token is skipped without being converted
+    DUMP_FIELD_ID,          ///< `id`
+    DUMP_FIELD_MOL,         ///< `mol`
+    DUMP_FIELD_TYPE,        ///< `type`
+    DUMP_FIELD_X,           ///< `x`, `xu`, `xs` or `xsu`
+    DUMP_FIELD_Y,           ///< `y`, `yu`, `ys` or `ysu`
+    DUMP_FIELD_Z,           ///< `z`, `zu`, `zs` or `zsu`
+    DUMP_FIELD_PROPERTY     ///< Any other column (vx, fx, ix, q, ...), stored as a double
+} DumpField;
+
+/**
+ * @struct DumpColumnMap
+ * @brief Which columns of an ATOMS line to convert, and where they go
+ * @param num_columns Number of columns of the ATOMS line
+ * @param num_used Columns up to the last requested one: the rest of each line is not tokenised
+ * @param num_properties Number of requested DUMP_FIELD_PROPERTY columns
+ * @param id_column Index of the `id` column, requested or not (-1 if the dump has none)
+ * @param has_field Non-zero for each DumpField (but DUMP_FIELD_PROPERTY) that was requested
+ * @param field What each column holds, DUMP_FIELD_SKIP if it was not requested
+ * @param property For DUMP_FIELD_PROPERTY columns, position among the requested properties
+ */
+typedef struct DumpColumnMap {
+    int num_columns;
+    int num_used;
+    int num_properties;
+    int id_column;
+    int has_field[DUMP_FIELD_PROPERTY];
+    int8_t field[DUMP_MAX_COLUMNS];
+    int16_t property[DUMP_MAX_COLUMNS];
+} DumpColumnMap;
+
+/**
+ * @brief The field a column name is loaded into
+ */
+DumpField dumpFieldFromName(const char* name, size_t len);
+
+/**
+ * @brief Match the requested columns against the column list of an ATOMS line.
+ * Properties are numbered in the order in which they are requested.
+ * @param columns, columns_end Column list of the ATOMS line, e.g. `DumpFrameHeader.columns`
+ * @param requested Space separated column names, e.g. "id xu yu zu" or "id vx vy vz"
+ *                  (NULL for "id mol type xu yu zu")
+ * @return 0 on success, -1 if a requested column is missing or positions are incomplete
+ */
+int buildDumpColumnMap(const char* columns, const char* columns_end, const char* requested, DumpColumnMap* map);
+
+/**
+ * @brief Parse `num_atoms` lines, converting only the columns selected by `map`
+ * @param coordinates Where to store x, y, z of each atom (NULL to ignore)
+ * @param atomIds, moleculeIds, atomTypes Where to store the integer columns (NULL to ignore)
+ * @param properties Where to store the requested properties, `map->num_properties` per atom (NULL to ignore)
+ * @return Pointer past the last atom line, NULL if the frame is truncated
+ */
+const char* parseDumpAtoms(const char* p, const char* end, int64_t num_atoms, const DumpColumnMap* map,
+                           double* coordinates, int64_t* atomIds, int64_t* moleculeIds, int64_t* atomTypes,
+                           double* properties);
+
+/**
+ * @struct DumpIdMap
+ * @brief Direct lookup table from atom id to the slot where the atom is stored
+ * @param max_id Largest id in the table
+ * @param slot `slot[id]` for 0 <= id <= max_id, -1 for atoms that are not loaded
+ * @param num_slots Number of atoms in the table
+ */
+typedef struct DumpIdMap {
+    int64_t max_id;
+    int64_t* slot;
+    int64_t num_slots;
+} DumpIdMap;
+
+/**
+ * @brief Build the table that stores atom `ids[k]` in slot k
+ * @return 0 on success, -1 on failure (negative or repeated ids)
+ */
+int buildDumpIdMap(const int64_t* ids, int64_t num_ids, DumpIdMap* map);
+
+/**
+ * @brief Free the table of a DumpIdMap
+ * @warning does NOT free the struct itself
+ */
+void freeDumpIdMap(DumpIdMap* map);
+
+/**
+ * @struct DumpSlotStamps
+ * @brief Which slots of a DumpIdMap were already filled in the current frame
+ * @param stamp Generation of the frame that last filled each slot (num_slots entries)
+ * @param generation Generation of the current frame: give every frame its own value
+ *        (e.g. a frame counter), so the table never needs to be cleared
+ */
+typedef struct DumpSlotStamps {
+    int64_t* stamp;
+    int64_t generation;
+} DumpSlotStamps;
+
+/**
+ * @brief Allocate the stamps of the slots of `ids`, none of them filled, with generation 0
+ * @return 0 on success, -1 on failure
+ */
+int initDumpSlotStamps(const DumpIdMap* ids, DumpSlotStamps* stamps);
+
+/**
+ * @brief Free the table of a DumpSlotStamps
+ * @warning does NOT free the struct itself
+ */
+void freeDumpSlotStamps(DumpSlotStamps* stamps);
+
+/**
+ * @brief Same as `parseDumpAtoms`, but each line is stored in the slot of its atom id.
+ * Lines of atoms that are not in `ids` are skipped after reading the id, without converting
+ * anything else. Destination arrays are indexed by slot.
+ * @param stamps Slots already filled in this frame (`stamps->generation` identifies the frame);
+ *        an id seen twice in the same frame is an error
+ * @param num_found Number of distinct atoms stored
+ * @return Pointer past the last atom line, NULL if the frame is truncated, the dump has no ids
+ *         or an atom appears twice
+ */
+const char* parseDumpAtomsById(const char* p, const char* end, int64_t num_atoms, const DumpColumnMap* map,
+                               const DumpIdMap* ids, DumpSlotStamps* stamps, double* coordinates,
+                               int64_t* moleculeIds, int64_t* atomTypes, double* properties, int64_t* num_found);
+
+/**
+ * @struct DumpFrameOffsets
+ * @brief Where each frame of a dump starts
+ * @param num_frames Number of complete frames found
+ * @param offsets Byte offset of the header of each frame
+ * @param timesteps Timestep of each frame
+ * @param num_atoms Number of atoms of each frame
+ */
+typedef struct DumpFrameOffsets {
+    int64_t num_frames;
+    int64_t* offsets;
+    int64_t* timesteps;
+    int64_t* num_atoms;
+} DumpFrameOffsets;
+
+/**
+ * @brief Find the start of every frame of the dump in `[data, data+size)`.
+ * Only the frame headers are parsed, atom lines are skipped by counting newlines.
+ * @return 0 on success, -1 on failure
+ */
+int scanDumpFrameOffsets(const char* data, size_t size, DumpFrameOffsets* fo);
+
+/**
+ * @brief Free the arrays of a DumpFrameOffsets
+ * @warning does NOT free the struct itself
+ */
+void freeDumpFrameOffsets(DumpFrameOffsets* fo);
@@ -0,0 +1,149 @@
+// dumpscan.h
+// Hand-written scanners to walk a LAMMPS dump kept in memory (e.g. a memory-mapped file).
+//
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @file dumpscan.h
+ *  @brief Number and line scanners working on a `[p, end)` character range.
+ *
+ *  The range does not need to be NUL terminated, so the scanners can run directly
+ *  on a memory-mapped file. Every scanner advances the cursor past what it consumed.
+ */
+
+/**
+ * @brief Skip spaces and tabs (not newlines)
+ */
+static inline const char* dumpSkipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+/**
+ * @brief Return the first character of the next line, or `end` if there is none
+ */
+static inline const char* dumpNextLine(const char* p, const char* end) {
+    const char* nl = memchr(p, '\n', (size_t) (end - p));
+    return nl ? nl + 1 : end;
+}
+
+/**
+ * @brief Skip `n` lines
+ */
+static inline const char* dumpSkipLines(const char* p, const char* end, int64_t n) {
+    while (n-- > 0 && p < end) p = dumpNextLine(p, end);
+    return p;
+}
+
+/**
+ * @brief Skip the next whitespace separated token without converting it
+ */
+static inline const char* dumpSkipToken(const char* p, const char* end) {
+    p = dumpSkipBlanks(p, end);
+    while (p < end && *p > ' ') p++;
+    return p;
+}
+
+/**
+ * @brief Check if the line starting at `p` begins with `prefix`
+ */
+static inline int dumpHasPrefix(const char* p, const char* end, const char* prefix, size_t len) {
+    return (size_t) (end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+/**
+ * @brief Parse a signed decimal integer
+ */
+static inline int64_t dumpScanInt64(const char** pp, const char* end) {
+    const char* p = dumpSkipBlanks(*pp, end);
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    uint64_t v = 0;
+    while (p < end && (unsigned) (*p - '0') < 10u) {
+        v = 10*v + (uint64_t) (*p - '0');
+        p++;
+    }
+    *pp = p;
+    return negative ? -(int64_t) v : (int64_t) v;
+}
+
+/**
+ * @brief Parse a floating point number.
+ *
+ * Numbers with at most 19 digits whose mantissa fits in 53 bits and whose decimal exponent is
+ * within ±22 are converted with a single exact multiplication or division, which gives the same
+ * correctly rounded result as `strtod`. Anything else (long mantissas, huge exponents, inf, nan)
+ * falls back to `strtod` on a NUL terminated copy of the token.
+ */
+static inline double dumpScanDouble(const char** pp, const char* end) {
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = dumpSkipBlanks(*pp, end);
+    const char* p = start;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while (p < end && (unsigned) (*p - '0') < 10u) {
+        mantissa = 10*mantissa + (uint64_t) (*p - '0');
+        digits++;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned) (*p - '0') < 10u) {
+            mantissa = 10*mantissa + (uint64_t) (*p - '0');
+            digits++;
+            exponent--;
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exp_negative = 0;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exp_negative = (*p == '-');
+            p++;
+        }
+        int e = 0;
+        while (p < end && (unsigned) (*p - '0') < 10u) {
+            if (e < 100000) e = 10*e + (*p - '0');
+            p++;
+        }
+        exponent += exp_negative ? -e : e;
+    }
+
+    if (digits > 0 && digits <= 19 && mantissa <= (UINT64_C(1) << 53)
+        && exponent >= -22 && exponent <= 22) {
+        double v = (double) mantissa;
+        v = (exponent < 0) ? v / pow10[-exponent] : v * pow10[exponent];
+        *pp = p;
+        return negative ? -v : v;
+    }
+
+    // Slow path
+    char token[128];
+    const char* token_end = dumpSkipToken(start, end);
+    size_t len = (size_t) (token_end - start);
+    if (len >= sizeof(token)) len = sizeof(token) - 1;
+    memcpy(token, start, len);
+    token[len] = '\0';
+    char* parsed_end;
+    const double v = strtod(token, &parsed_end);
+    *pp = start + (parsed_end - token);
+    return v;
+}
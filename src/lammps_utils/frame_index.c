@@ -0,0 +1,176 @@
+// frame_index.c
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "frame_index.h"
+#include "mapped_file.h"
+
+static const char INDEX_MAGIC[8] = {'G', 'G', 'L', 'I', 'D', 'X', '0', '1'};
+
+// Size and modification time (ns) of a file
+static int statDump(const char* filename, int64_t* size, int64_t* mtime) {
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        fprintf(stderr, "Error: Cannot stat file: %s\n", filename);
+        return -1;
+    }
+    *size  = (int64_t) st.st_size;
+    *mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + (int64_t) st.st_mtim.tv_nsec;
+    return 0;
+}
+
+int buildLAMMPSFrameIndex(const char* filename, LAMMPSFrameIndex* index) {
+    if (statDump(filename, &index->dump_size, &index->dump_mtime) != 0) {
+        return -1;
+    }
+
+    MappedFile mf;
+    if (openMappedFile(&mf, filename) != 0) {
+        return -1;
+    }
+    adviseSequentialMappedFile(&mf);
+    const int status = scanDumpFrameOffsets(mf.data, mf.size, &index->frames);
+    closeMappedFile(&mf);
+    return status;
+}
+
+int writeLAMMPSFrameIndex(const char* index_filename, const LAMMPSFrameIndex* index) {
+    FILE* file = fopen(index_filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error opening file: %s\n", index_filename);
+        return -1;
+    }
+
+    const DumpFrameOffsets* fo = &index->frames;
+    int ok = fwrite(INDEX_MAGIC, sizeof(INDEX_MAGIC), 1, file) == 1
+          && fwrite(&index->dump_size, sizeof(int64_t), 1, file) == 1
+          && fwrite(&index->dump_mtime, sizeof(int64_t), 1, file) == 1
+          && fwrite(&fo->num_frames, sizeof(int64_t), 1, file) == 1;
+
+    for (int64_t f = 0; ok && f < fo->num_frames; f++) {
+        const int64_t record[3] = {fo->timesteps[f], fo->offsets[f], fo->num_atoms[f]};
+        ok = fwrite(record, sizeof(record), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error: Failed to write index: %s\n", index_filename);
+        remove(index_filename);
+        return -1;
+    }
+    return 0;
+}
+
+int readLAMMPSFrameIndex(const char* index_filename, LAMMPSFrameIndex* index) {
+    DumpFrameOffsets* fo = &index->frames;
+    fo->num_frames = 0;
+    fo->offsets = NULL;
+    fo->timesteps = NULL;
+    fo->num_atoms = NULL;
+
+    FILE* file = fopen(index_filename, "rb");
+    if (!file) {
+        return -1;
+    }
+
+    char magic[8];
+    int64_t num_frames;
+    int ok = fread(magic, sizeof(magic), 1, file) == 1
+          && memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0
+          && fread(&index->dump_size, sizeof(int64_t), 1, file) == 1
+          && fread(&index->dump_mtime, sizeof(int64_t), 1, file) == 1
+          && fread(&num_frames, sizeof(int64_t), 1, file) == 1
+          && num_frames >= 0;
+
+    if (ok) {
+        fo->num_frames = num_frames;
+        fo->offsets    = malloc(num_frames * sizeof(int64_t));
+        fo->timesteps  = malloc(num_frames * sizeof(int64_t));
+        fo->num_atoms  = malloc(num_frames * sizeof(int64_t));
+        ok = num_frames == 0 || (fo->offsets && fo->timesteps && fo->num_atoms);
+    }
+    for (int64_t f = 0; ok && f < num_frames; f++) {
+        int64_t record[3];
+        ok = fread(record, sizeof(record), 1, file) == 1;
+        if (ok) {
+            fo->timesteps[f] = record[0];
+            fo->offsets[f]   = record[1];
+            fo->num_atoms[f] = record[2];
+        }
+    }
+    fclose(file);
+
+    if (!ok) {
+        fprintf(stderr, "Error: Invalid index file: %s\n", index_filename);
+        freeDumpFrameOffsets(fo);
+        return -1;
+    }
+    return 0;
+}
+
+int isLAMMPSFrameIndexCurrent(const char* filename, const LAMMPSFrameIndex* index) {
+    int64_t size, mtime;
+    if (statDump(filename, &size, &mtime) != 0) {
+        return -1;
+    }
+    return index->dump_size == size && index->dump_mtime == mtime;
+}
+
+int openLAMMPSFrameIndex(const char* filename, LAMMPSFrameIndex* index) {
+    char* index_filename = malloc(strlen(filename) + 5);
+    if (!index_filename) {
+        fprintf(stderr, "Error: Memory allocation failed in openLAMMPSFrameIndex.\n");
+        return -1;
+    }
+    strcpy(index_filename, filename);
+    strcat(index_filename, ".idx");
+
+    // Reuse the sidecar only if it describes the dump as it is now
+    if (readLAMMPSFrameIndex(index_filename, index) == 0) {
+        const int current = isLAMMPSFrameIndexCurrent(filename, index);
+        if (current == 1) {
+            free(index_filename);
+            return 0;
+        }
+        freeLAMMPSFrameIndex(index);
+        if (current < 0) {
+            free(index_filename);
+            return -1;
+        }
+    }
+
+    if (buildLAMMPSFrameIndex(filename, index) != 0) {
+        free(index_filename);
+        return -1;
+    }
+    // A read-only directory is not fatal: the index is just not persisted
+    if (writeLAMMPSFrameIndex(index_filename, index) != 0) {
+        fprintf(stderr, "Warning: Index of %s not saved.\n", filename);
+    }
+    free(index_filename);
+    return 0;
+}
+
+int64_t lowerBoundLAMMPSFrame(const LAMMPSFrameIndex* index, int64_t timestep) {
+    int64_t lo = 0;
+    int64_t hi = index->frames.num_frames;
+    while (lo < hi) {
+        const int64_t mid = lo + (hi - lo) / 2;
+        if (index->frames.timesteps[mid] < timestep) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void freeLAMMPSFrameIndex(LAMMPSFrameIndex* index) {
+    freeDumpFrameOffsets(&index->frames);
+    index->dump_size = 0;
+    index->dump_mtime = 0;
+}
@@ -0,0 +1,70 @@
+// frame_index.h
+// Persistent index of the frames of a LAMMPS dump.
+//
+#pragma once
+
+#include <stdint.h>
+
+#include "dumpframe.h"
+
+/**
+ * @struct LAMMPSFrameIndex
+ * @brief Byte offset, timestep and atom count of every frame of a dump
+ * @param frames Offsets, timesteps and atom counts of the frames
+ * @param dump_size Size of the dump when the index was built
+ * @param dump_mtime Modification time of the dump (ns) when the index was built
+ *
+ * The index is stored next to the dump as `<dump>.idx`:
+ * an 8 byte magic, dump size, dump mtime and number of frames (int64 each), then
+ * one {timestep, offset, num_atoms} int64 triplet per frame.
+ */
+typedef struct LAMMPSFrameIndex {
+    DumpFrameOffsets frames;
+    int64_t dump_size;
+    int64_t dump_mtime;
+} LAMMPSFrameIndex;
+
+/**
+ * @brief Scan the dump and build its index
+ * @return 0 on success, -1 on failure
+ */
+int buildLAMMPSFrameIndex(const char* filename, LAMMPSFrameIndex* index);
+
+/**
+ * @brief Write the index to `index_filename`
+ * @return 0 on success, -1 on failure
+ */
+int writeLAMMPSFrameIndex(const char* index_filename, const LAMMPSFrameIndex* index);
+
+/**
+ * @brief Read an index previously written by `writeLAMMPSFrameIndex`
+ * @return 0 on success, -1 on failure
+ */
+int readLAMMPSFrameIndex(const char* index_filename, LAMMPSFrameIndex* index);
+
+/**
+ * @brief Load the sidecar index `<filename>.idx` of a dump.
+ * If the sidecar is missing, or the size or mtime of the dump changed since it was written,
+ * the index is rebuilt and the sidecar is rewritten.
+ * @return 0 on success, -1 on failure
+ */
+int openLAMMPSFrameIndex(const char* filename, LAMMPSFrameIndex* index);
+
+/**
+ * @brief Check that the dump still has the size and mtime it had when `index` was built
+ * @return 1 if the index describes the dump as it is now, 0 if it is stale, -1 if the dump cannot be read
+ */
+int isLAMMPSFrameIndexCurrent(const char* filename, const LAMMPSFrameIndex* index);
+
+/**
+ * @brief Position of the first frame with timestep >= `timestep` (binary search).
+ * @warning Timesteps are assumed to be increasing, as LAMMPS writes them.
+ * @return Frame position, `num_frames` if every frame is before `timestep`
+ */
+int64_t lowerBoundLAMMPSFrame(const LAMMPSFrameIndex* index, int64_t timestep);
+
+/**
+ * @brief Free the arrays of the index
+ * @warning does NOT free the struct itself
+ */
+void freeLAMMPSFrameIndex(LAMMPSFrameIndex* index);
@@ -0,0 +1,60 @@
+// mapped_file.c
+//
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+static int mapFile(MappedFile* mf, const char* filename, const int prot) {
+    mf->data = NULL;
+    mf->size = 0;
+
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: Empty or unreadable file: %s\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    void* data = mmap(NULL, (size_t) st.st_size, prot, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map file: %s\n", filename);
+        return -1;
+    }
+
+    mf->data = (const char*) data;
+    mf->size = (size_t) st.st_size;
+    return 0;
+}
+
+int openMappedFile(MappedFile* mf, const char* filename) {
+    return mapFile(mf, filename, PROT_READ);
+}
+
+int openMappedFileCopyOnWrite(MappedFile* mf, const char* filename) {
+    return mapFile(mf, filename, PROT_READ | PROT_WRITE);
+}
+
+void adviseSequentialMappedFile(const MappedFile* mf) {
+    if (mf->data) {
+        madvise((void*) mf->data, mf->size, MADV_SEQUENTIAL);
+    }
+}
+
+void closeMappedFile(MappedFile* mf) {
+    if (mf->data) {
+        munmap((void*) mf->data, mf->size);
+    }
+    mf->data = NULL;
+    mf->size = 0;
+}
@@ -0,0 +1,43 @@
+// mapped_file.h
+// Read-only memory mapping of a whole file.
+//
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @struct MappedFile
+ * @brief A file mapped read-only in memory
+ * @param data First byte of the file
+ * @param size Size of the file in bytes
+ */
+typedef struct MappedFile {
+    const char* data;
+    size_t size;
+} MappedFile;
+
+/**
+ * @brief Map the whole file in memory (read-only)
+ * @param mf The MappedFile to fill
+ * @param filename The file to map
+ * @return 0 on success, -1 on failure
+ */
+int openMappedFile(MappedFile* mf, const char* filename);
+
+/**
+ * @brief Map the whole file in memory, copy-on-write.
+ * The mapping can be modified, changes are private to the process and never reach the file.
+ * @return 0 on success, -1 on failure
+ */
+int openMappedFileCopyOnWrite(MappedFile* mf, const char* filename);
+
+/**
+ * @brief Hint the kernel that the mapping will be read front to back
+ */
+void adviseSequentialMappedFile(const MappedFile* mf);
+
+/**
+ * @brief Unmap the file
+ * @warning does NOT free the struct itself
+ */
+void closeMappedFile(MappedFile* mf);
@@ -1,9 +1,15 @@
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <omp.h>
 
+#include "dumpframe.h"
+#include "dumpscan.h"
+#include "mapped_file.h"
 #include "rarray.h"
 #include "parser.h"
+#include "trjstream.h"
 
 void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ) {
     FILE* file = fopen(filename, "r");
@@ -30,33 +36,34 @@ void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ)
     rarray* box_buff        = rarray_init(sizeof(double),  initialCapacity);
 
     while(fgets(line, sizeof(line), file)) {
-        // The first time we see the atom list, we construct the atom list
-        if (!atom_list_constructed && strstr(line, "ITEM: ATOMS id mol type xu yu zu")) {
+        // Let's also read the box. The loop stops on the ATOMS line that follows, so the atom
+        // list below is built from the same (first) frame
+        if (!box_found && strstr(line, "ITEM: BOX BOUNDS pp pp pp")) {
             while(fgets(line, sizeof(line), file)) {
                 if (strstr(line, "ITEM")) {
                     break;
                 }
-                if (sscanf(line, "%ld %ld %ld", &atomId, &molId, &atomType) == 3) {
-                    rarray_push(atomIds_buf, &atomId);
-                    rarray_push(moleculeIds_buf, &molId);
-                    rarray_push(atomTypes_buf, &atomType);
+                if (sscanf(line, "%lf %lf", &box_min, &box_max) == 2) {
+                    rarray_push(box_buff, &box_min);
+                    rarray_push(box_buff, &box_max);
                 }
             }
-            atom_list_constructed = 1;
+            box_found = 1;
         }
 
-        // Let's also read the box
-        if (!box_found && strstr(line, "ITEM: BOX BOUNDS pp pp pp")) {
+        // The first time we see the atom list, we construct the atom list
+        if (!atom_list_constructed && strstr(line, "ITEM: ATOMS id mol type xu yu zu")) {
             while(fgets(line, sizeof(line), file)) {
                 if (strstr(line, "ITEM")) {
                     break;
                 }
-                if (sscanf(line, "%lf %lf", &box_min, &box_max) == 2) {
-                    rarray_push(box_buff, &box_min);
-                    rarray_push(box_buff, &box_max);
+                if (sscanf(line, "%ld %ld %ld", &atomId, &molId, &atomType) == 3) {
+                    rarray_push(atomIds_buf, &atomId);
+                    rarray_push(moleculeIds_buf, &molId);
+                    rarray_push(atomTypes_buf, &atomType);
                 }
             }
-            box_found = 1;
+            atom_list_constructed = 1;
         }
 
 
@@ -81,6 +88,15 @@ void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ)
     }
     fclose(file);
 
+    // Coordinates are read by readLAMMPSCoordinates
+    data->coordinates = NULL;
+    data->mapping = NULL;
+    data->num_properties = 0;
+    data->propertyNames = NULL;
+    data->properties = NULL;
+    data->moleculeIndex = (LAMMPSGroupIndex) {-1, NULL, NULL};
+    data->typeIndex = (LAMMPSGroupIndex) {-1, NULL, NULL};
+
     // Convert rarray buffers to normal arrays
     data->num_timesteps = (int64_t)     rarray_size(timesteps_buf);
     data->timesteps     = (int64_t*)    rarray_to_array(timesteps_buf);
@@ -96,6 +112,8 @@ void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ)
     rarray_free(atomTypes_buf);
     rarray_free(box_buff);
 
+    indexLAMMPSData(data);
+
     // Compute deltaTimestep
     if (data->num_timesteps > 1) {
         data->deltaTimestep = data->timesteps[1] - data->timesteps[0];
@@ -108,21 +126,42 @@ void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ)
 
 
 void readLAMMPSCoordinates(const char* filename, LAMMPSData* data, const int64_t T_EQ) {
+    /*
+     * Every line is stored in the slot of its atom id (as listed by `initLAMMPSData`), so frames
+     * written in a different atom order, e.g. by several MPI ranks, are loaded consistently.
+     * On failure `data->coordinates` is left NULL.
+     */
+    data->coordinates = NULL;
     FILE* file = fopen(filename, "r");
     if (!file) {
         fprintf(stderr, "Error opening file: %s\n", filename);
         return;
     }
 
+    const int64_t N = data->num_atoms;
+    const size_t frame_len = 3 * (size_t) N;
+    DumpIdMap index = {-1, NULL, 0};
+    DumpSlotStamps stamps = {NULL, 0};
+    double* coordinates = malloc((data->num_timesteps * N > 0 ? data->num_timesteps * frame_len : 1) * sizeof(double));
+    if (!coordinates) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld frames of %ld atoms.\n", data->num_timesteps, N);
+    }
+    if (!coordinates || buildDumpIdMap(data->atomIds, N, &index) != 0 || initDumpSlotStamps(&index, &stamps) != 0) {
+        free(coordinates);
+        freeDumpIdMap(&index);
+        fclose(file);
+        return;
+    }
+
     char line[1024];
-    int atomId, molId, atomType;
+    long atomId, molId, atomType;
     double x, y, z;
-
-    rarray* coordinates_buff   = rarray_init(sizeof(double), 10);
-
     int64_t timestep = 0;
+    int64_t frame_atoms = 0;
+    int64_t frame = 0;
+    int valid = 1;
 
-    while (fgets(line, sizeof(line), file)) {
+    while (valid && fgets(line, sizeof(line), file)) {
 
         if (strstr(line, "ITEM: TIMESTEP")) {
             if (fgets(line, sizeof(line), file)) {
@@ -130,35 +169,854 @@ void readLAMMPSCoordinates(const char* filename, LAMMPSData* data, const int64_t
             }
         }
 
-        if (strstr(line, "ITEM: ATOMS id mol type xu yu zu")) {
-            while (fgets(line, sizeof(line), file)) {
-                if (sscanf(line, "%d %d %d %lf %lf %lf", &atomId, &molId, &atomType, &x, &y, &z) == 6) {
-                    if (timestep >= T_EQ) {
-                        rarray_push(coordinates_buff, &x);
-                        rarray_push(coordinates_buff, &y);
-                        rarray_push(coordinates_buff, &z);
-                    }
-                    if (atomId == data->atomIds[data->num_atoms-1]) {
-                        break;
-                    }
+        if (strstr(line, "ITEM: NUMBER OF ATOMS")) {
+            if (fgets(line, sizeof(line), file)) {
+                frame_atoms = atoll(line);
+            }
+        }
+
+        // Atom lines of frames before T_EQ never match an ITEM and are skipped by the outer loop
+        if (timestep >= T_EQ && strstr(line, "ITEM: ATOMS id mol type xu yu zu")) {
+            if (frame >= data->num_timesteps) {
+                fprintf(stderr, "Error: %s has more frames than the %ld listed.\n", filename, data->num_timesteps);
+                valid = 0;
+                break;
+            }
+            double* dst = coordinates + frame * frame_len;
+            stamps.generation = frame;
+            int64_t found = 0;
+            for (int64_t i = 0; valid && i < frame_atoms && fgets(line, sizeof(line), file); i++) {
+                if (sscanf(line, "%ld %ld %ld %lf %lf %lf", &atomId, &molId, &atomType, &x, &y, &z) != 6) {
+                    fprintf(stderr, "Error: Malformed atom line at timestep %ld: %s", timestep, line);
+                    valid = 0;
+                    break;
                 }
+                const int64_t k = (atomId >= 0 && atomId <= index.max_id) ? index.slot[atomId] : -1;
+                if (k < 0) {
+                    fprintf(stderr, "Error: Atom id %ld at timestep %ld is not in the first frame.\n", atomId, timestep);
+                    valid = 0;
+                } else if (stamps.stamp[k] == stamps.generation) {
+                    fprintf(stderr, "Error: Atom id %ld appears twice in the same frame.\n", atomId);
+                    valid = 0;
+                } else {
+                    stamps.stamp[k] = stamps.generation;
+                    dst[3*k]   = x;
+                    dst[3*k+1] = y;
+                    dst[3*k+2] = z;
+                    found++;
+                }
+            }
+            if (valid && found != N) {
+                fprintf(stderr, "Error: Frame at timestep %ld has %ld atoms instead of %ld.\n", timestep, found, N);
+                valid = 0;
             }
+            frame++;
         }
 
     }
     fclose(file);
+    freeDumpSlotStamps(&stamps);
+    freeDumpIdMap(&index);
+
+    if (valid && frame != data->num_timesteps) {
+        fprintf(stderr, "Error: %s has %ld frames instead of the %ld listed.\n", filename, frame, data->num_timesteps);
+        valid = 0;
+    }
+    if (!valid) {
+        free(coordinates);
+        return;
+    }
+    data->coordinates = coordinates;
+}
+
+// Grow the frame-major coordinate buffer so that it can hold at least `num_frames` frames
+static int reserveFrames(double** coordinates, size_t* capacity, const size_t num_frames, const size_t frame_len) {
+    if (num_frames <= *capacity) {
+        return 0;
+    }
+    size_t new_capacity = (*capacity > 0) ? *capacity : 1;
+    while (new_capacity < num_frames) {
+        new_capacity *= 2;
+    }
+    double* new_coordinates = realloc(*coordinates, new_capacity * frame_len * sizeof(double));
+    if (!new_coordinates) {
+        fprintf(stderr, "Error: Memory allocation failed for %zu frames.\n", new_capacity);
+        return -1;
+    }
+    *coordinates = new_coordinates;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Reset every field so that freeLAMMPSData is safe whatever happens during a load
+static void clearLAMMPSData(LAMMPSData* data) {
+    data->deltaTimestep = 0;
+    data->num_atoms = 0;
+    data->num_timesteps = 0;
+    data->box = NULL;
+    data->atomIds = NULL;
+    data->moleculeIds = NULL;
+    data->atomTypes = NULL;
+    data->coordinates = NULL;
+    data->timesteps = NULL;
+    data->mapping = NULL;
+    data->num_properties = 0;
+    data->propertyNames = NULL;
+    data->properties = NULL;
+    data->moleculeIndex = (LAMMPSGroupIndex) {-1, NULL, NULL};
+    data->typeIndex = (LAMMPSGroupIndex) {-1, NULL, NULL};
+}
+
+// Counting sort of the atoms by key. Returns 1 if the table was built, 0 if the keys do not fit a
+// direct table (negative, or spread over a range much larger than the number of atoms), -1 on failure
+static int buildGroupIndex(const int64_t* keys, const int64_t num_atoms, LAMMPSGroupIndex* index) {
+    index->max_key = -1;
+    index->offsets = NULL;
+    index->members = NULL;
+    if (!keys) {
+        return 0;
+    }
+
+    for (int64_t i = 0; i < num_atoms; i++) {
+        if (keys[i] < 0) {
+            return 0;
+        }
+        if (keys[i] > index->max_key) index->max_key = keys[i];
+    }
+    if (index->max_key > 4 * num_atoms + 1024) {
+        index->max_key = -1;
+        return 0;
+    }
+
+    index->offsets = calloc((size_t) (index->max_key + 2), sizeof(int64_t));
+    index->members = malloc((num_atoms > 0 ? num_atoms : 1) * sizeof(int64_t));
+    if (!index->offsets || !index->members) {
+        fprintf(stderr, "Error: Memory allocation failed for the index of %ld atoms.\n", num_atoms);
+        free(index->offsets);
+        free(index->members);
+        index->offsets = NULL;
+        index->members = NULL;
+        index->max_key = -1;
+        return -1;
+    }
+
+    for (int64_t i = 0; i < num_atoms; i++) {
+        index->offsets[keys[i] + 1]++;
+    }
+    for (int64_t k = 0; k <= index->max_key; k++) {
+        index->offsets[k + 1] += index->offsets[k];
+    }
+    // offsets[k] is used as the insertion point of key k, then shifted back
+    for (int64_t i = 0; i < num_atoms; i++) {
+        index->members[index->offsets[keys[i]]++] = i;
+    }
+    for (int64_t k = index->max_key; k > 0; k--) {
+        index->offsets[k] = index->offsets[k - 1];
+    }
+    index->offsets[0] = 0;
+    return 1;
+}
+
+static void freeGroupIndex(LAMMPSGroupIndex* index) {
+    free(index->offsets);
+    free(index->members);
+    index->offsets = NULL;
+    index->members = NULL;
+    index->max_key = -1;
+}
+
+int indexLAMMPSData(LAMMPSData* data) {
+    freeGroupIndex(&data->moleculeIndex);
+    freeGroupIndex(&data->typeIndex);
+    if (buildGroupIndex(data->moleculeIds, data->num_atoms, &data->moleculeIndex) < 0
+        || buildGroupIndex(data->atomTypes, data->num_atoms, &data->typeIndex) < 0) {
+        return -1;
+    }
+    return 0;
+}
 
-    data->coordinates = (double*) rarray_to_array(coordinates_buff);
-    rarray_free(coordinates_buff);
+// Copy the names of the requested columns that are stored as properties, in request order
+static char** copyPropertyNames(const char* requested, const int64_t num_properties) {
+    char** names = calloc(num_properties > 0 ? num_properties : 1, sizeof(char*));
+    if (!names) {
+        return NULL;
+    }
+    const char* p = requested ? requested : "";
+    const char* end = p + strlen(p);
+    int64_t k = 0;
+    while (p < end && k < num_properties) {
+        while (p < end && *p <= ' ') p++;
+        const char* name_end = dumpSkipToken(p, end);
+        const size_t len = (size_t) (name_end - p);
+        if (len > 0 && dumpFieldFromName(p, len) == DUMP_FIELD_PROPERTY) {
+            names[k] = malloc(len + 1);
+            if (!names[k]) {
+                for (int64_t j = 0; j < k; j++) free(names[j]);
+                free(names);
+                return NULL;
+            }
+            memcpy(names[k], p, len);
+            names[k][len] = '\0';
+            k++;
+        }
+        p = name_end;
+    }
+    return names;
+}
+
+int loadLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ) {
+    clearLAMMPSData(data);
+
+    LAMMPSStream* stream = openLAMMPSStream(filename);
+    if (!stream) {
+        return -1;
+    }
+
+    int status = 0;
+    int64_t num_frames = 0;     // Frames seen in the file
+    int64_t num_kept = 0;       // Frames with timestep >= T_EQ
+    size_t capacity = 0;        // Allocated frames in `coordinates`
+    size_t frame_len = 0;       // Doubles per frame
+
+    rarray* timesteps_buf = rarray_init(sizeof(int64_t), 1);
+    double* coordinates = NULL;
+    DumpIdMap order = {-1, NULL, 0};   // Slot of each atom id, from the first frame
+    LAMMPSFrame frame;
+    initLAMMPSFrame(&frame);
+
+    int read;
+    while ((read = readLAMMPSFrameHeader(stream, &frame)) == 1) {
+        const int first_frame = (num_frames == 0);
+        const int keep = (frame.timestep >= T_EQ);
+        num_frames++;
+
+        if (first_frame) {
+            // First frame: size every per-atom buffer once
+            data->num_atoms   = frame.num_atoms;
+            frame_len         = 3 * (size_t) frame.num_atoms;
+            data->atomIds     = malloc(frame.num_atoms * sizeof(int64_t));
+            data->moleculeIds = malloc(frame.num_atoms * sizeof(int64_t));
+            data->atomTypes   = malloc(frame.num_atoms * sizeof(int64_t));
+            data->box         = malloc(6 * sizeof(double));
+            if (!data->atomIds || !data->moleculeIds || !data->atomTypes || !data->box) {
+                fprintf(stderr, "Error: Memory allocation failed for %ld atoms.\n", frame.num_atoms);
+                status = -1;
+                break;
+            }
+            memcpy(data->box, frame.box, 6 * sizeof(double));
+        } else if (frame.num_atoms != data->num_atoms) {
+            fprintf(stderr, "Error: Frame at timestep %ld has %ld atoms instead of %ld.\n",
+                    frame.timestep, frame.num_atoms, data->num_atoms);
+            status = -1;
+            break;
+        }
+
+        if (!first_frame && !keep) {
+            status = skipLAMMPSFrameAtoms(stream, frame.num_atoms);
+        } else {
+            double* slot = NULL;
+            if (keep) {
+                if (reserveFrames(&coordinates, &capacity, num_kept + 1, frame_len) != 0) {
+                    status = -1;
+                    break;
+                }
+                slot = coordinates + num_kept * frame_len;
+            }
+            if (first_frame) {
+                status = readLAMMPSFrameAtoms(stream, frame.num_atoms, slot,
+                                              data->atomIds, data->moleculeIds, data->atomTypes);
+                if (status == 0) {
+                    status = buildDumpIdMap(data->atomIds, data->num_atoms, &order);
+                }
+            } else {
+                // Atoms may come in any order (multi-rank dumps): scatter them by id
+                status = readLAMMPSFrameAtomsById(stream, frame.num_atoms, &order, slot);
+            }
+        }
+        if (status != 0) {
+            break;
+        }
+        if (keep) {
+            rarray_push(timesteps_buf, &frame.timestep);
+            num_kept++;
+        }
+
+        // Once the first frame is in, its size on disk tells us roughly how many frames to expect
+        if (first_frame) {
+            const int64_t frame_bytes = tellLAMMPSStream(stream);
+            if (frame_bytes > 0) {
+                const size_t expected = (size_t) (sizeLAMMPSStream(stream) / frame_bytes) + 1;
+                if (reserveFrames(&coordinates, &capacity, expected, frame_len) != 0) {
+                    status = -1;
+                    break;
+                }
+            }
+        }
+    }
+    if (read < 0) {
+        status = -1;
+    }
+    freeDumpIdMap(&order);
+    closeLAMMPSStream(stream);
+
+    data->num_timesteps = (int64_t) rarray_size(timesteps_buf);
+    data->timesteps     = (int64_t*) rarray_to_array(timesteps_buf);
+    rarray_free(timesteps_buf);
+
+    // Release the unused tail of the coordinates buffer
+    if (coordinates && num_kept > 0 && (size_t) num_kept < capacity) {
+        double* shrunk = realloc(coordinates, num_kept * frame_len * sizeof(double));
+        if (shrunk) coordinates = shrunk;
+    }
+    data->coordinates = coordinates;
+
+    if (status != 0) {
+        return status;
+    }
+
+    if (indexLAMMPSData(data) != 0) {
+        return -1;
+    }
+
+    if (data->num_timesteps > 1) {
+        data->deltaTimestep = data->timesteps[1] - data->timesteps[0];
+    } else {
+        fprintf(stderr, "Error: less than 2 timesteps found.\n");
+        data->deltaTimestep = 0;
+    }
+    return 0;
+}
+
+int loadLAMMPSDataMapped(const char* filename, LAMMPSData* data, const int64_t T_EQ) {
+    MappedFile mf;
+    if (openMappedFile(&mf, filename) != 0) {
+        return -1;
+    }
+    adviseSequentialMappedFile(&mf);
+
+    const char* p   = mf.data;
+    const char* end = mf.data + mf.size;
+
+    int status = 0;
+    int64_t num_frames = 0;
+    int64_t num_kept = 0;
+    size_t capacity = 0;
+    size_t frame_len = 0;
+    DumpFrameHeader hdr;
+    DumpColumnMap map;
+
+    rarray* timesteps_buf = rarray_init(sizeof(int64_t), 1);
+    double* coordinates = NULL;
+    DumpIdMap order = {-1, NULL, 0};   // Slot of each atom id, from the first frame
+    DumpSlotStamps stamps = {NULL, 0};
+
+    clearLAMMPSData(data);
+
+    const char* atoms;
+    while ((atoms = parseDumpFrameHeader(p, end, &hdr)) != NULL) {
+        const int first_frame = (num_frames == 0);
+        const int keep = (hdr.timestep >= T_EQ);
+        num_frames++;
+
+        if (buildDumpColumnMap(hdr.columns, hdr.columns_end, NULL, &map) != 0) {
+            fprintf(stderr, "Error: Unsupported atom columns at timestep %ld.\n", hdr.timestep);
+            status = -1;
+            break;
+        }
+
+        if (first_frame) {
+            data->num_atoms   = hdr.num_atoms;
+            frame_len         = 3 * (size_t) hdr.num_atoms;
+            data->atomIds     = malloc(hdr.num_atoms * sizeof(int64_t));
+            data->moleculeIds = malloc(hdr.num_atoms * sizeof(int64_t));
+            data->atomTypes   = malloc(hdr.num_atoms * sizeof(int64_t));
+            data->box         = malloc(6 * sizeof(double));
+            if (!data->atomIds || !data->moleculeIds || !data->atomTypes || !data->box) {
+                fprintf(stderr, "Error: Memory allocation failed for %ld atoms.\n", hdr.num_atoms);
+                status = -1;
+                break;
+            }
+            memcpy(data->box, hdr.box, 6 * sizeof(double));
+        } else if (hdr.num_atoms != data->num_atoms) {
+            fprintf(stderr, "Error: Frame at timestep %ld has %ld atoms instead of %ld.\n",
+                    hdr.timestep, hdr.num_atoms, data->num_atoms);
+            status = -1;
+            break;
+        }
+
+        double* frame = NULL;
+        if (keep) {
+            if (reserveFrames(&coordinates, &capacity, num_kept + 1, frame_len) != 0) {
+                status = -1;
+                break;
+            }
+            frame = coordinates + num_kept * frame_len;
+        }
+
+        const char* next;
+        int64_t num_found = hdr.num_atoms;
+        if (first_frame) {
+            next = parseDumpAtoms(atoms, end, hdr.num_atoms, &map, frame,
+                                  data->atomIds, data->moleculeIds, data->atomTypes, NULL);
+            if (next && (buildDumpIdMap(data->atomIds, data->num_atoms, &order) != 0
+                         || initDumpSlotStamps(&order, &stamps) != 0)) {
+                status = -1;
+                break;
+            }
+        } else if (keep) {
+            // Atoms may come in any order (multi-rank dumps): scatter them by id
+            stamps.generation = num_frames;
+            next = parseDumpAtomsById(atoms, end, hdr.num_atoms, &map, &order, &stamps, frame,
+                                      NULL, NULL, NULL, &num_found);
+        } else {
+            next = dumpSkipLines(atoms, end, hdr.num_atoms);
+        }
+        if (!next || num_found != data->num_atoms) {
+            fprintf(stderr, "Error: Truncated frame, or atoms of the first frame missing, at timestep %ld.\n", hdr.timestep);
+            status = -1;
+            break;
+        }
+        if (keep) {
+            rarray_push(timesteps_buf, &hdr.timestep);
+            num_kept++;
+        }
+
+        // All frames have the same size on disk up to number formatting
+        if (first_frame && next > mf.data) {
+            const size_t expected = mf.size / (size_t) (next - mf.data) + 1;
+            if (reserveFrames(&coordinates, &capacity, expected, frame_len) != 0) {
+                status = -1;
+                break;
+            }
+        }
+        p = next;
+    }
+    freeDumpSlotStamps(&stamps);
+    freeDumpIdMap(&order);
+    closeMappedFile(&mf);
+
+    data->num_timesteps = (int64_t) rarray_size(timesteps_buf);
+    data->timesteps     = (int64_t*) rarray_to_array(timesteps_buf);
+    rarray_free(timesteps_buf);
+
+    if (coordinates && num_kept > 0 && (size_t) num_kept < capacity) {
+        double* shrunk = realloc(coordinates, num_kept * frame_len * sizeof(double));
+        if (shrunk) coordinates = shrunk;
+    }
+    data->coordinates = coordinates;
+
+    if (status != 0) {
+        return status;
+    }
+
+    if (indexLAMMPSData(data) != 0) {
+        return -1;
+    }
+
+    if (data->num_timesteps > 1) {
+        data->deltaTimestep = data->timesteps[1] - data->timesteps[0];
+    } else {
+        fprintf(stderr, "Error: less than 2 timesteps found.\n");
+        data->deltaTimestep = 0;
+    }
+    return 0;
+}
+
+// Parse the frames at `offsets` of a mapped dump, each one straight into its slot of `data->coordinates`.
+// Atom ids, molecule ids, types and box are taken from the frame at `topology_offset`.
+// Only the `columns` requested (NULL for "id mol type xu yu zu") are converted and, when `ids` is
+// not NULL, only the atoms it lists, in its order. With `whole_frames` the atoms of `ids` are all the
+// atoms of the topology frame, and every frame must have exactly that many atoms.
+static int loadMappedFramesById(const MappedFile* mf, const int64_t topology_offset,
+                            const int64_t* offsets, const int64_t* timesteps, const int64_t num_frames,
+                            const char* columns, const DumpIdMap* ids, const int whole_frames,
+                            LAMMPSData* data, const int num_threads) {
+    const char* end = mf->data + mf->size;
+
+    DumpFrameHeader hdr;
+    DumpColumnMap map;
+    const char* atoms = parseDumpFrameHeader(mf->data + topology_offset, end, &hdr);
+    if (!atoms) {
+        fprintf(stderr, "Error: No frame header at offset %ld.\n", topology_offset);
+        return -1;
+    }
+    if (buildDumpColumnMap(hdr.columns, hdr.columns_end, columns, &map) != 0) {
+        fprintf(stderr, "Error: Unsupported atom columns at timestep %ld.\n", hdr.timestep);
+        return -1;
+    }
+    const int64_t num_atoms = ids ? ids->num_slots : hdr.num_atoms;
+    const int64_t num_properties = map.num_properties;
+    const size_t frame_len = map.has_field[DUMP_FIELD_X] ? 3 * (size_t) num_atoms : 0;
+    const size_t properties_len = (size_t) (num_atoms * num_properties);
+
+    data->num_atoms      = num_atoms;
+    data->num_timesteps  = num_frames;
+    data->num_properties = num_properties;
+    data->atomIds        = map.has_field[DUMP_FIELD_ID]   ? malloc(num_atoms * sizeof(int64_t)) : NULL;
+    data->moleculeIds    = map.has_field[DUMP_FIELD_MOL]  ? malloc(num_atoms * sizeof(int64_t)) : NULL;
+    data->atomTypes      = map.has_field[DUMP_FIELD_TYPE] ? malloc(num_atoms * sizeof(int64_t)) : NULL;
+    data->box            = malloc(6 * sizeof(double));
+    data->timesteps      = malloc(num_frames * sizeof(int64_t));
+    data->coordinates    = frame_len > 0 ? malloc(num_frames * frame_len * sizeof(double)) : NULL;
+    data->properties     = properties_len > 0 ? malloc(num_frames * properties_len * sizeof(double)) : NULL;
+    data->propertyNames  = num_properties > 0 ? copyPropertyNames(columns, num_properties) : NULL;
+    if ((map.has_field[DUMP_FIELD_ID] && !data->atomIds)
+        || (map.has_field[DUMP_FIELD_MOL] && !data->moleculeIds)
+        || (map.has_field[DUMP_FIELD_TYPE] && !data->atomTypes) || !data->box
+        || (num_properties > 0 && !data->propertyNames)
+        || (num_frames > 0 && (!data->timesteps || (frame_len > 0 && !data->coordinates)
+                               || (properties_len > 0 && !data->properties)))) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld frames of %ld atoms.\n", num_frames, num_atoms);
+        return -1;
+    }
+    memcpy(data->box, hdr.box, 6 * sizeof(double));
+    memcpy(data->timesteps, timesteps, num_frames * sizeof(int64_t));
+    if (!ids) {
+        parseDumpAtoms(atoms, end, num_atoms, &map, NULL, data->atomIds, data->moleculeIds, data->atomTypes, NULL);
+    } else {
+        int64_t num_found = 0;
+        DumpSlotStamps stamps;
+        if (initDumpSlotStamps(ids, &stamps) != 0) {
+            return -1;
+        }
+        const char* parsed = parseDumpAtomsById(atoms, end, hdr.num_atoms, &map, ids, &stamps, NULL,
+                                                data->moleculeIds, data->atomTypes, NULL, &num_found);
+        freeDumpSlotStamps(&stamps);
+        if (!parsed || num_found != num_atoms) {
+            fprintf(stderr, "Error: Only %ld of the %ld selected atoms are in the dump.\n", num_found, num_atoms);
+            return -1;
+        }
+        if (data->atomIds) {
+            for (int64_t id = 0; id <= ids->max_id; id++) {
+                if (ids->slot[id] >= 0) data->atomIds[ids->slot[id]] = id;
+            }
+        }
+    }
+
+    // Frames are independent: parse them concurrently, each thread with its own slot stamps
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        DumpSlotStamps stamps = {NULL, 0};
+        if (ids && initDumpSlotStamps(ids, &stamps) != 0) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int64_t f = 0; f < num_frames; f++) {
+            if (ids && !stamps.stamp) continue;
+            DumpFrameHeader frame_hdr;
+            DumpColumnMap frame_map;
+            double* frame_coordinates = frame_len > 0 ? data->coordinates + f * frame_len : NULL;
+            double* frame_properties = properties_len > 0 ? data->properties + f * properties_len : NULL;
+            const char* frame_atoms = parseDumpFrameHeader(mf->data + offsets[f], end, &frame_hdr);
+            int ok = frame_atoms
+                     && buildDumpColumnMap(frame_hdr.columns, frame_hdr.columns_end, columns, &frame_map) == 0;
+            if (ok && !ids) {
+                ok = frame_hdr.num_atoms == num_atoms
+                     && parseDumpAtoms(frame_atoms, end, num_atoms, &frame_map, frame_coordinates,
+                                       NULL, NULL, NULL, frame_properties);
+            } else if (ok) {
+                int64_t num_found;
+                stamps.generation = f;
+                ok = (!whole_frames || frame_hdr.num_atoms == num_atoms)
+                     && parseDumpAtomsById(frame_atoms, end, frame_hdr.num_atoms, &frame_map, ids, &stamps,
+                                           frame_coordinates, NULL, NULL, frame_properties, &num_found)
+                     && num_found == num_atoms;
+            }
+            if (!ok) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        freeDumpSlotStamps(&stamps);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Some frames are truncated or do not have the %ld expected atoms.\n", num_atoms);
+        return -1;
+    }
+
+    if (indexLAMMPSData(data) != 0) {
+        return -1;
+    }
+
+    if (data->num_timesteps > 1) {
+        data->deltaTimestep = data->timesteps[1] - data->timesteps[0];
+    } else {
+        fprintf(stderr, "Error: less than 2 timesteps found.\n");
+        data->deltaTimestep = 0;
+    }
+    return 0;
+}
+
+// Slot of each atom in the order of the frame at `topology_offset`.
+// Returns 1 if the table was built, 0 if the dump has no id column, -1 on failure.
+static int buildTopologyOrder(const MappedFile* mf, const int64_t topology_offset, DumpIdMap* order) {
+    const char* end = mf->data + mf->size;
+    DumpFrameHeader hdr;
+    DumpColumnMap map;
+    const char* atoms = parseDumpFrameHeader(mf->data + topology_offset, end, &hdr);
+    if (!atoms) {
+        fprintf(stderr, "Error: No frame header at offset %ld.\n", topology_offset);
+        return -1;
+    }
+    if (buildDumpColumnMap(hdr.columns, hdr.columns_end, "", &map) != 0 || map.id_column < 0) {
+        return 0;
+    }
+    if (buildDumpColumnMap(hdr.columns, hdr.columns_end, "id", &map) != 0) {
+        return -1;
+    }
+
+    int64_t* atomIds = malloc((hdr.num_atoms > 0 ? hdr.num_atoms : 1) * sizeof(int64_t));
+    if (!atomIds) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld atoms.\n", hdr.num_atoms);
+        return -1;
+    }
+    int status = -1;
+    if (!parseDumpAtoms(atoms, end, hdr.num_atoms, &map, NULL, atomIds, NULL, NULL, NULL)) {
+        fprintf(stderr, "Error: Truncated frame at timestep %ld.\n", hdr.timestep);
+    } else if (buildDumpIdMap(atomIds, hdr.num_atoms, order) == 0) {
+        status = 1;
+    }
+    free(atomIds);
+    return status;
+}
+
+// As `loadMappedFramesById`. Without a selection the atoms are stored in the order of the topology
+// frame and the lines of every frame are scattered by id, so dumps written in a different order at
+// each step (multi-rank runs) load correctly, in O(N) per frame.
+static int loadMappedFrames(const MappedFile* mf, const int64_t topology_offset,
+                            const int64_t* offsets, const int64_t* timesteps, const int64_t num_frames,
+                            const char* columns, const DumpIdMap* ids, LAMMPSData* data, const int num_threads) {
+    if (ids) {
+        return loadMappedFramesById(mf, topology_offset, offsets, timesteps, num_frames, columns, ids, 0,
+                                    data, num_threads);
+    }
+
+    DumpIdMap order;
+    const int has_order = buildTopologyOrder(mf, topology_offset, &order);
+    if (has_order < 0) {
+        return -1;
+    }
+    const int status = loadMappedFramesById(mf, topology_offset, offsets, timesteps, num_frames, columns,
+                                            has_order ? &order : NULL, 1, data, num_threads);
+    if (has_order) freeDumpIdMap(&order);
+    return status;
+}
+
+void initLAMMPSReadOptions(LAMMPSReadOptions* options) {
+    options->columns = NULL;
+    options->atom_ids = NULL;
+    options->num_atom_ids = 0;
+    options->first_timestep = INT64_MIN;
+    options->last_timestep = INT64_MAX;
+    options->stride = 1;
+    options->index = NULL;
+    options->num_threads = 0;
+}
+
+// Offsets and timesteps of the frames in the timestep window, one every `stride`. Returns how many.
+// With an index the window is found by binary search, otherwise the (already scanned) frames are filtered.
+static int64_t selectFrames(const LAMMPSReadOptions* options, const DumpFrameOffsets* fo,
+                            int64_t* offsets, int64_t* timesteps) {
+    int64_t first = 0;
+    int64_t last = fo->num_frames;
+    if (options->index) {
+        first = lowerBoundLAMMPSFrame(options->index, options->first_timestep);
+        if (options->last_timestep != INT64_MAX) {
+            last = lowerBoundLAMMPSFrame(options->index, options->last_timestep + 1);
+        }
+    }
+
+    const int64_t stride = (options->stride > 1) ? options->stride : 1;
+    int64_t num_in_window = 0;
+    int64_t num_selected = 0;
+    for (int64_t f = first; f < last; f++) {
+        if (fo->timesteps[f] < options->first_timestep || fo->timesteps[f] > options->last_timestep) {
+            continue;
+        }
+        if (num_in_window++ % stride == 0) {
+            offsets[num_selected]   = fo->offsets[f];
+            timesteps[num_selected] = fo->timesteps[f];
+            num_selected++;
+        }
+    }
+    return num_selected;
+}
+
+// A caller-supplied index must describe the dump as it is now (size and mtime, as
+// openLAMMPSFrameIndex checks), and as it was mapped
+static int checkMappedDumpIndex(const char* filename, const LAMMPSFrameIndex* index, const MappedFile* mf) {
+    if ((int64_t) mf->size != index->dump_size || isLAMMPSFrameIndexCurrent(filename, index) != 1) {
+        fprintf(stderr, "Error: The index of %s is stale.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int loadLAMMPSDataWithOptions(const char* filename, LAMMPSData* data, const LAMMPSReadOptions* options) {
+    clearLAMMPSData(data);
+
+    // Slot of each selected atom
+    DumpIdMap ids;
+    if (options->atom_ids) {
+        if (options->num_atom_ids <= 0) {
+            fprintf(stderr, "Error: Empty atom selection.\n");
+            return -1;
+        }
+        if (buildDumpIdMap(options->atom_ids, options->num_atom_ids, &ids) != 0) {
+            return -1;
+        }
+    }
+
+    MappedFile mf;
+    if (openMappedFile(&mf, filename) != 0) {
+        if (options->atom_ids) freeDumpIdMap(&ids);
+        return -1;
+    }
+
+    // Phase 1: find where every frame starts, from the index when there is one
+    DumpFrameOffsets scanned = {0, NULL, NULL, NULL};
+    const DumpFrameOffsets* fo = &scanned;
+    int status = 0;
+    if (options->index) {
+        fo = &options->index->frames;
+        status = checkMappedDumpIndex(filename, options->index, &mf);
+    } else {
+        status = scanDumpFrameOffsets(mf.data, mf.size, &scanned);
+    }
+    if (status == 0 && fo->num_frames == 0) {
+        fprintf(stderr, "Error: No frames found in %s\n", filename);
+        status = -1;
+    }
+
+    // Frames to keep
+    int64_t* offsets = NULL;
+    int64_t* timesteps = NULL;
+    int64_t num_kept = 0;
+    if (status == 0) {
+        offsets   = malloc(fo->num_frames * sizeof(int64_t));
+        timesteps = malloc(fo->num_frames * sizeof(int64_t));
+        if (!offsets || !timesteps) {
+            fprintf(stderr, "Error: Memory allocation failed for %ld frames.\n", fo->num_frames);
+            status = -1;
+        } else {
+            num_kept = selectFrames(options, fo, offsets, timesteps);
+        }
+    }
+
+    // Phase 2: parse the frames in parallel
+    if (status == 0) {
+        status = loadMappedFrames(&mf, fo->offsets[0], offsets, timesteps, num_kept, options->columns,
+                                  options->atom_ids ? &ids : NULL, data, options->num_threads);
+    }
+
+    free(offsets);
+    free(timesteps);
+    if (options->atom_ids) freeDumpIdMap(&ids);
+    freeDumpFrameOffsets(&scanned);
+    closeMappedFile(&mf);
+    return status;
+}
+
+int loadLAMMPSDataParallel(const char* filename, LAMMPSData* data, const int64_t T_EQ, const int num_threads) {
+    LAMMPSReadOptions options;
+    initLAMMPSReadOptions(&options);
+    options.first_timestep = T_EQ;
+    options.num_threads = num_threads;
+    return loadLAMMPSDataWithOptions(filename, data, &options);
+}
+
+int loadLAMMPSFrameRange(const char* filename, const LAMMPSFrameIndex* index,
+                         const int64_t first_timestep, const int64_t last_timestep,
+                         LAMMPSData* data, const int num_threads) {
+    LAMMPSReadOptions options;
+    initLAMMPSReadOptions(&options);
+    options.index = index;
+    options.first_timestep = first_timestep;
+    options.last_timestep = last_timestep;
+    options.num_threads = num_threads;
+    return loadLAMMPSDataWithOptions(filename, data, &options);
+}
+
+int loadLAMMPSFrame(const char* filename, const LAMMPSFrameIndex* index, const int64_t timestep,
+                    const int64_t* atomIds, const int64_t num_atoms, double* coordinates) {
+    const int64_t f = lowerBoundLAMMPSFrame(index, timestep);
+    if (f >= index->frames.num_frames || index->frames.timesteps[f] != timestep) {
+        fprintf(stderr, "Error: Timestep %ld not found in %s\n", timestep, filename);
+        return -1;
+    }
+
+    DumpIdMap ids = {-1, NULL, 0};
+    DumpSlotStamps stamps = {NULL, 0};
+    if (atomIds && (buildDumpIdMap(atomIds, num_atoms, &ids) != 0 || initDumpSlotStamps(&ids, &stamps) != 0)) {
+        freeDumpIdMap(&ids);
+        return -1;
+    }
+
+    MappedFile mf;
+    if (openMappedFile(&mf, filename) != 0) {
+        freeDumpSlotStamps(&stamps);
+        freeDumpIdMap(&ids);
+        return -1;
+    }
+    const char* end = mf.data + mf.size;
+
+    int status = 0;
+    DumpFrameHeader hdr;
+    DumpColumnMap map;
+    const char* atoms = NULL;
+    if (checkMappedDumpIndex(filename, index, &mf) != 0) {
+        status = -1;
+    } else if (!(atoms = parseDumpFrameHeader(mf.data + index->frames.offsets[f], end, &hdr))
+               || hdr.timestep != timestep || buildDumpColumnMap(hdr.columns, hdr.columns_end, NULL, &map) != 0) {
+        fprintf(stderr, "Error: Failed to read timestep %ld of %s\n", timestep, filename);
+        status = -1;
+    } else if (!atomIds) {
+        if (hdr.num_atoms != num_atoms) {
+            fprintf(stderr, "Error: Timestep %ld has %ld atoms, expected %ld.\n", timestep, hdr.num_atoms, num_atoms);
+            status = -1;
+        } else if (!parseDumpAtoms(atoms, end, num_atoms, &map, coordinates, NULL, NULL, NULL, NULL)) {
+            status = -1;
+        }
+    } else {
+        int64_t num_found = 0;
+        if (!parseDumpAtomsById(atoms, end, hdr.num_atoms, &map, &ids, &stamps, coordinates,
+                                NULL, NULL, NULL, &num_found)) {
+            status = -1;
+        } else if (num_found != num_atoms) {
+            fprintf(stderr, "Error: Only %ld of the %ld atoms are in timestep %ld.\n", num_found, num_atoms, timestep);
+            status = -1;
+        }
+    }
+    closeMappedFile(&mf);
+    freeDumpSlotStamps(&stamps);
+    freeDumpIdMap(&ids);
+    return status;
 }
 
 void freeLAMMPSData(LAMMPSData* data) {
     free(data->timesteps);
     free(data->atomIds);
-    free(data->coordinates);
+    if (data->mapping) {
+        // Coordinates live in the mapping
+        closeMappedFile(data->mapping);
+        free(data->mapping);
+        data->mapping = NULL;
+    } else {
+        free(data->coordinates);
+    }
     free(data->moleculeIds);
     free(data->atomTypes);
     free(data->box);
+    if (data->propertyNames) {
+        for (int64_t k = 0; k < data->num_properties; k++) free(data->propertyNames[k]);
+        free(data->propertyNames);
+    }
+    free(data->properties);
+    freeGroupIndex(&data->moleculeIndex);
+    freeGroupIndex(&data->typeIndex);
 }
 
 void checkTimestepMismatch(const LAMMPSData* data) {
@@ -180,34 +1038,109 @@ void checkTimestepMismatch(const LAMMPSData* data) {
 }
 
 
-void writeLAMMPSData(const char* filename, const LAMMPSData* data) {
+// printf at the end of `*buffer`, growing it when the text does not fit
+static int appendFormatted(char** buffer, size_t* capacity, size_t* length, const char* format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        const int n = vsnprintf(*buffer + *length, *capacity - *length, format, args);
+        va_end(args);
+        if (n < 0) {
+            return -1;
+        }
+        if ((size_t) n < *capacity - *length) {
+            *length += (size_t) n;
+            return 0;
+        }
+        size_t new_capacity = 2 * *capacity;
+        while (new_capacity - *length <= (size_t) n) new_capacity *= 2;
+        char* new_buffer = realloc(*buffer, new_capacity);
+        if (!new_buffer) {
+            return -1;
+        }
+        *buffer = new_buffer;
+        *capacity = new_capacity;
+    }
+}
+
+// Format frame `t` of `data` into `*buffer`; returns the number of bytes, -1 on failure
+static int64_t formatLAMMPSFrame(const LAMMPSData* data, const int64_t t, char** buffer, size_t* capacity) {
+    const int64_t offset = 3*t * data->num_atoms;
+    size_t length = 0;
+    int status = 0;
+
+    status |= appendFormatted(buffer, capacity, &length, "ITEM: TIMESTEP\n%ld\n", data->timesteps[t]);
+    status |= appendFormatted(buffer, capacity, &length, "ITEM: NUMBER OF ATOMS\n%ld\n", data->num_atoms);
+    status |= appendFormatted(buffer, capacity, &length, "ITEM: BOX BOUNDS pp pp pp\n");
+    status |= appendFormatted(buffer, capacity, &length, "%.16e %.16e\n", data->box[0], data->box[1]);
+    status |= appendFormatted(buffer, capacity, &length, "%.16e %.16e\n", data->box[2], data->box[3]);
+    status |= appendFormatted(buffer, capacity, &length, "%.16e %.16e\n", data->box[4], data->box[5]);
+    status |= appendFormatted(buffer, capacity, &length, "ITEM: ATOMS id mol type xu yu zu\n");
+    for (int64_t i = 0; i < data->num_atoms && status == 0; i++) {
+        const double* x = data->coordinates + offset + 3*i;
+        // Common case: the line fits in the free space, a single snprintf
+        const size_t room = *capacity - length;
+        const int n = snprintf(*buffer + length, room, "%10ld %6ld %3ld %12.6f %12.6f %12.6f\n",
+                               data->atomIds[i], data->moleculeIds[i], data->atomTypes[i], x[0], x[1], x[2]);
+        if (n >= 0 && (size_t) n < room) {
+            length += (size_t) n;
+        } else {
+            status = appendFormatted(buffer, capacity, &length, "%10ld %6ld %3ld %12.6f %12.6f %12.6f\n",
+                                     data->atomIds[i], data->moleculeIds[i], data->atomTypes[i], x[0], x[1], x[2]);
+        }
+    }
+    return (status == 0) ? (int64_t) length : -1;
+}
+
+int writeLAMMPSDataParallel(const char* filename, const LAMMPSData* data, const int num_threads) {
     FILE* file = fopen(filename, "w");
     if (!file) {
         fprintf(stderr, "Error opening file: %s\n", filename);
-        return;
+        return -1;
     }
 
-    // Write a single timestep
-    for (int64_t t = 0; t < data->num_timesteps; t++)
+    // Each thread formats whole frames into its own buffer; frames are written in order, so
+    // formatting of the next frames overlaps with the write of the current one
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
     {
-        int64_t offset = 3*t * data->num_atoms;
-        fprintf(file, "ITEM: TIMESTEP\n");
-        fprintf(file, "%ld\n", data->timesteps[t]);
+        size_t capacity = 64 * (size_t) (data->num_atoms + 16);
+        char* buffer = malloc(capacity);
+        int thread_failed = (buffer == NULL);
 
-        fprintf(file, "ITEM: NUMBER OF ATOMS\n");
-        fprintf(file, "%ld\n", data->num_atoms);
-
-        fprintf(file, "ITEM: BOX BOUNDS pp pp pp\n");
-        fprintf(file, "%.16e %.16e\n", data->box[0], data->box[1]);
-        fprintf(file, "%.16e %.16e\n", data->box[2], data->box[3]);
-        fprintf(file, "%.16e %.16e\n", data->box[4], data->box[5]);
-
-        fprintf(file, "ITEM: ATOMS id mol type xu yu zu\n");
-        for (int i = 0; i < data->num_atoms; i++) {
-            fprintf(file, "%10ld %6ld %3ld %12.6f %12.6f %12.6f\n", data->atomIds[i], data->moleculeIds[i], data->atomTypes[i],
-                    data->coordinates[offset+3*i], data->coordinates[offset+3*i+1], data->coordinates[offset+3*i+2]);
+        #pragma omp for ordered schedule(dynamic)
+        for (int64_t t = 0; t < data->num_timesteps; t++) {
+            const int64_t length = thread_failed ? -1 : formatLAMMPSFrame(data, t, &buffer, &capacity);
+            #pragma omp ordered
+            {
+                int write_failed;
+                #pragma omp atomic read
+                write_failed = failed;
+                if (length < 0) {
+                    thread_failed = 1;
+                    write_failed = 1;
+                } else if (!write_failed && fwrite(buffer, 1, (size_t) length, file) != (size_t) length) {
+                    write_failed = 1;
+                }
+                if (write_failed) {
+                    #pragma omp atomic write
+                    failed = 1;
+                }
+            }
         }
+        free(buffer);
     }
 
-    fclose(file);
-}
\ No newline at end of file
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "Error writing file: %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+void writeLAMMPSData(const char* filename, const LAMMPSData* data) {
+    writeLAMMPSDataParallel(filename, data, 1);
+}
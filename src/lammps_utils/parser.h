@@ -1,8 +1,25 @@
 #ifndef LAMMPS_DATA_H
 #define LAMMPS_DATA_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "frame_index.h"
+#include "mapped_file.h"
+
+/**
+ * @struct LAMMPSGroupIndex
+ * @brief CSR table from a key (molecule id or atom type) to the atoms that have it
+ * @param max_key Largest key in the table (-1 if the table is empty)
+ * @param offsets Atoms with key k are members[offsets[k]] ... members[offsets[k+1]-1] (max_key+2 entries)
+ * @param members Position of each atom in `LAMMPSData.atomIds`, grouped by key, in increasing order
+ */
+typedef struct LAMMPSGroupIndex {
+    int64_t max_key;
+    int64_t* offsets;
+    int64_t* members;
+} LAMMPSGroupIndex;
+
 // Struct to hold LAMMPS data
 typedef struct {
     int64_t deltaTimestep;    // Delta timestep
@@ -14,12 +31,165 @@ typedef struct {
     int64_t* atomTypes;       // Atom types array
     double* coordinates;      // Coordinates array (x, y, z for each atom)
     int64_t* timesteps;       // Timesteps array
+    MappedFile* mapping;      // Non-NULL when coordinates point into a memory-mapped file
+    int64_t num_properties;   // Number of extra per-atom columns loaded (velocities, forces, ...)
+    char** propertyNames;     // Column name of each property
+    double* properties;       // Properties array (num_properties values for each atom of each frame)
+    LAMMPSGroupIndex moleculeIndex;  // Atoms of each molecule (offsets NULL if not built)
+    LAMMPSGroupIndex typeIndex;      // Atoms of each type (offsets NULL if not built)
 } LAMMPSData;
 
+/**
+ * @brief What `loadLAMMPSDataWithOptions` reads from a dump
+ * @param columns Space separated ATOMS columns to load (NULL for "id mol type xu yu zu").
+ *                `id`, `mol` and `type` go to the topology arrays, positions (`xu yu zu`, `x y z`, ...)
+ *                to `coordinates`; any other column (e.g. "vx vy vz") is stored in `properties`.
+ *                Columns not listed are skipped without being converted.
+ * @param atom_ids Ids of the atoms to keep, e.g. from `getAtomsFromType` (NULL to keep every atom).
+ *                 Atoms are stored in this order; lines of other atoms are skipped after reading the id.
+ * @param num_atom_ids Length of `atom_ids`
+ * @param first_timestep, last_timestep Only frames with first_timestep <= timestep <= last_timestep are kept
+ * @param stride Keep one frame every `stride` inside the window (e.g. 10 for every 10th frame)
+ * @param index Frame index of the dump (see `openLAMMPSFrameIndex`), NULL to find the frames with a
+ *              line counting pass. Frames that are not kept are never parsed either way.
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ */
+typedef struct LAMMPSReadOptions {
+    const char* columns;
+    const int64_t* atom_ids;
+    int64_t num_atom_ids;
+    int64_t first_timestep;
+    int64_t last_timestep;
+    int64_t stride;
+    const LAMMPSFrameIndex* index;
+    int num_threads;
+} LAMMPSReadOptions;
+
 // Function declarations
 void initLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ);
+
+/**
+ * @brief Read the coordinates of the frames listed by `initLAMMPSData`.
+ * Each line is stored in the slot of its atom id in `data->atomIds`, so frames may list the atoms
+ * in any order (multi-rank dumps). Every frame must have exactly the atoms of the first frame.
+ * On failure an error is printed and `data->coordinates` is left NULL.
+ */
 void readLAMMPSCoordinates(const char* filename, LAMMPSData* data, const int64_t T_EQ);
+
+/**
+ * @brief Load a whole dump in a single pass.
+ * Fills timesteps, atom ids, molecule ids, types, box and coordinates in one read of the file,
+ * replacing the `initLAMMPSData` + `readLAMMPSCoordinates` pair. Only frames with
+ * timestep >= T_EQ are kept; ids, types and box are taken from the first frame.
+ * @return 0 on success, -1 on failure
+ */
+int loadLAMMPSData(const char* filename, LAMMPSData* data, const int64_t T_EQ);
+
+/**
+ * @brief Same as `loadLAMMPSData`, but the dump is memory-mapped and walked in place.
+ * `ITEM:` headers are matched by prefix and numbers are converted by the scanners in
+ * `dumpscan.h` instead of `fgets` + `sscanf`. The resulting LAMMPSData is identical.
+ * @return 0 on success, -1 on failure
+ */
+int loadLAMMPSDataMapped(const char* filename, LAMMPSData* data, const int64_t T_EQ);
+
+/**
+ * @brief Two-phase parallel loader.
+ * A first pass over the mapped dump only finds where each frame starts (atom lines are skipped
+ * by counting newlines); the frames are then parsed concurrently, each one straight into its
+ * slot of `coordinates`. The resulting LAMMPSData is identical to `loadLAMMPSData`.
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ * @return 0 on success, -1 on failure
+ */
+int loadLAMMPSDataParallel(const char* filename, LAMMPSData* data, const int64_t T_EQ, const int num_threads);
+
+/**
+ * @brief Set `options` to load every frame and atom with the default columns
+ */
+void initLAMMPSReadOptions(LAMMPSReadOptions* options);
+
+/**
+ * @brief Parallel loader (as `loadLAMMPSDataParallel`) that converts only the requested columns.
+ * The ATOMS header is parsed once per frame into a column map, so dumps with extra columns
+ * (velocities, forces, image flags) load at the cost of the columns that are actually used.
+ * Arrays of columns that are not requested are left NULL, e.g. `coordinates` for "id vx vy vz".
+ * With `atom_ids` only the selected atoms are stored, so memory scales with the selection.
+ * @return 0 on success, -1 on failure (e.g. a requested column is not in the dump)
+ */
+int loadLAMMPSDataWithOptions(const char* filename, LAMMPSData* data, const LAMMPSReadOptions* options);
+
+/**
+ * @brief Load the frames with first_timestep <= timestep <= last_timestep using a frame index.
+ * Only the requested frames (and the first frame, for ids and box) are read, so the cost does
+ * not depend on the size of the dump. Pass INT64_MAX as `last_timestep` to read until the end.
+ * @param index Index of the dump, see `openLAMMPSFrameIndex`
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ * @return 0 on success, -1 on failure
+ */
+int loadLAMMPSFrameRange(const char* filename, const LAMMPSFrameIndex* index,
+                         const int64_t first_timestep, const int64_t last_timestep,
+                         LAMMPSData* data, const int num_threads);
+
+/**
+ * @brief Read the coordinates of a single timestep using a frame index.
+ * Atoms are stored by id, so frames written in a different atom order (multi-rank dumps)
+ * land in the same slots as the ones loaded with `loadLAMMPSData`.
+ * @param atomIds Id of the atom of each slot (e.g. `data->atomIds`), or NULL to keep the order of the file
+ * @param num_atoms Number of slots of `coordinates`. Without `atomIds` the frame must have exactly
+ *        this many atoms; with `atomIds` every listed atom must be in the frame
+ * @param coordinates Where to store x, y, z of each atom. Expected length: 3*num_atoms
+ * @return 0 on success, -1 on failure (e.g. timestep not in the dump, or missing atoms)
+ */
+int loadLAMMPSFrame(const char* filename, const LAMMPSFrameIndex* index, const int64_t timestep,
+                    const int64_t* atomIds, const int64_t num_atoms, double* coordinates);
+/**
+ * @brief Load a binary trajectory written by `lammpsbinIO` (see lammpsbinIO.h for the layout).
+ * The file is memory-mapped; double precision coordinates are used in place, without a copy,
+ * and the mapping is released by `freeLAMMPSData`. Writes to `coordinates` are private to the
+ * process (copy-on-write). Single precision and compressed files are converted to double,
+ * compressed ones decoding independent keyframe segments in parallel.
+ * @return 0 on success, -1 on failure
+ */
+int loadLAMMPSBinary(const char* filename, LAMMPSData* data);
+
+/**
+ * @brief Convert a text dump into the binary trajectory format
+ * @param single_precision If non-zero coordinates are stored as float
+ * @return 0 on success, -1 on failure
+ */
+int convertLAMMPSDumpToBinary(const char* dump_filename, const char* binary_filename, int single_precision);
+
+/**
+ * @brief Convert a text dump into a compressed binary trajectory (see trjcodec.h).
+ * Coordinates are kept with an absolute error of at most precision/2.
+ * @param precision Quantisation step, in the units of the coordinates (e.g. 1e-3)
+ * @param keyframe_interval Distance between frames stored without delta encoding (0: first frame only)
+ * @return 0 on success, -1 on failure
+ */
+int convertLAMMPSDumpToCompressed(const char* dump_filename, const char* binary_filename,
+                                  double precision, size_t keyframe_interval);
+
+/**
+ * @brief Build `moleculeIndex` and `typeIndex` from the molecule ids and types of `data`.
+ * Called by the loaders; a table is left empty when its column was not loaded or its keys are
+ * negative or too sparse for a direct table (selections then scan the atoms).
+ * @return 0 on success, -1 on failure
+ */
+int indexLAMMPSData(LAMMPSData* data);
+
 void checkTimestepMismatch(const LAMMPSData* data);
 void freeLAMMPSData(LAMMPSData* data);
+/**
+ * @brief Write `data` as a dump with the `id mol type xu yu zu` columns
+ * @warning Requires ids, molecule ids, types and coordinates
+ */
 void writeLAMMPSData(const char* filename, const LAMMPSData* data);
+
+/**
+ * @brief Same output as `writeLAMMPSData`, byte for byte, with frames formatted in parallel.
+ * Each thread formats whole frames into a private buffer and the buffers are written in frame order.
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ * @return 0 on success, -1 on failure
+ */
+int writeLAMMPSDataParallel(const char* filename, const LAMMPSData* data, const int num_threads);
 #endif // LAMMPS_DATA_H
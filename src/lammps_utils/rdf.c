@@ -0,0 +1,184 @@
+// rdf.c
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "neighbours.h"
+#include "rdf.h"
+
+// Histogram of the pairs of one thread, filled by the cell list of gg_math
+typedef struct RdfHistogram {
+    const int64_t* types;   // Pair-index row of each atom (its type), NULL for the total g(r) only
+    double inv_dr;
+    int64_t num_bins;
+    int64_t num_types;
+    uint64_t* hist;
+} RdfHistogram;
+
+static void countPair(size_t i, size_t j, double dx, double dy, double dz, double r2, void* ctx) {
+    (void) dx; (void) dy; (void) dz;
+    RdfHistogram* h = ctx;
+    int64_t bin = (int64_t) (sqrt(r2) * h->inv_dr);
+    if (bin >= h->num_bins) bin = h->num_bins - 1;
+    int64_t pair = 0;
+    if (h->types) {
+        const int64_t ti = h->types[i];
+        const int64_t tj = h->types[j];
+        pair = ti <= tj ? ti * h->num_types + tj : tj * h->num_types + ti;
+    }
+    h->hist[pair * h->num_bins + bin]++;
+}
+
+int computeLAMMPSRdf(const LAMMPSData* data, const double r_max, const int64_t num_bins, const int by_type,
+                     const int num_threads, LAMMPSRdf* rdf) {
+    const int64_t N = data->num_atoms;
+    const int64_t T = data->num_timesteps;
+
+    rdf->num_bins = num_bins;
+    rdf->r_max = r_max;
+    rdf->dr = num_bins > 0 ? r_max / (double) num_bins : 0.;
+    rdf->num_types = 0;
+    rdf->num_frames = T;
+    rdf->r = NULL;
+    rdf->g = NULL;
+    rdf->g_pairs = NULL;
+
+    if (!data->coordinates || !data->box) {
+        fprintf(stderr, "Error: No coordinates or box to compute g(r).\n");
+        return -1;
+    }
+    if (T == 0) {
+        fprintf(stderr, "Error: No frames to compute g(r).\n");
+        return -1;
+    }
+    if (num_bins <= 0 || !(r_max > 0.)) {
+        fprintf(stderr, "Error: Invalid g(r) histogram, %ld bins up to %lf.\n", num_bins, r_max);
+        return -1;
+    }
+    if (by_type && !data->atomTypes) {
+        fprintf(stderr, "Error: Atom types are needed for the g(r) of each pair of types.\n");
+        return -1;
+    }
+
+    double L[3];
+    for (int d = 0; d < 3; d++) {
+        L[d] = data->box[2*d+1] - data->box[2*d];
+        if (!(2. * r_max <= L[d])) {
+            fprintf(stderr, "Error: The g(r) cutoff %lf is larger than half the box side %lf.\n", r_max, L[d]);
+            return -1;
+        }
+    }
+
+    int64_t num_types = 1;
+    if (by_type) {
+        for (int64_t i = 0; i < N; i++) {
+            if (data->atomTypes[i] < 0) {
+                fprintf(stderr, "Error: Negative type %ld of atom %ld.\n", data->atomTypes[i], data->atomIds[i]);
+                return -1;
+            }
+            if (data->atomTypes[i] >= num_types) num_types = data->atomTypes[i] + 1;
+        }
+    }
+    const int64_t hist_len = num_types * num_types * num_bins;
+
+    uint64_t* hist = calloc((size_t) hist_len, sizeof(uint64_t));
+    rdf->r = malloc(num_bins * sizeof(double));
+    rdf->g = calloc((size_t) num_bins, sizeof(double));
+    if (by_type) rdf->g_pairs = calloc((size_t) hist_len, sizeof(double));
+    if (!hist || !rdf->r || !rdf->g || (by_type && !rdf->g_pairs)) {
+        fprintf(stderr, "Error: Memory allocation failed for the g(r) histograms.\n");
+        free(hist);
+        freeLAMMPSRdf(rdf);
+        return -1;
+    }
+
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        CellList cells;
+        RdfHistogram local = {by_type ? data->atomTypes : NULL, (double) num_bins / r_max, num_bins, num_types,
+                              calloc((size_t) hist_len, sizeof(uint64_t))};
+        const int ok = initCellList(&cells, L, r_max, (size_t) N) == 0 && local.hist;
+        if (!ok) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int64_t t = 0; t < T; t++) {
+            if (!ok) continue;
+            const double* frame = data->coordinates + 3 * t * N;
+            buildCellList(&cells, frame);
+            forEachPairCellList(&cells, countPair, &local);
+        }
+
+        if (ok) {
+            #pragma omp critical
+            for (int64_t k = 0; k < hist_len; k++) {
+                hist[k] += local.hist[k];
+            }
+        }
+        freeCellList(&cells);
+        free(local.hist);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Memory allocation failed for the g(r) cell lists.\n");
+        free(hist);
+        freeLAMMPSRdf(rdf);
+        return -1;
+    }
+
+    // Normalise by the pairs an ideal gas at the same density has in each shell
+    int64_t* counts = calloc((size_t) num_types, sizeof(int64_t));
+    if (!counts) {
+        fprintf(stderr, "Error: Memory allocation failed for the g(r) histograms.\n");
+        free(hist);
+        freeLAMMPSRdf(rdf);
+        return -1;
+    }
+    for (int64_t i = 0; i < N; i++) {
+        counts[by_type ? data->atomTypes[i] : 0]++;
+    }
+
+    const double volume = L[0] * L[1] * L[2];
+    const double dr = rdf->dr;
+    const double total_pairs = 0.5 * (double) N * (double) (N - 1);
+    for (int64_t b = 0; b < num_bins; b++) {
+        const double r0 = b * dr;
+        const double r1 = r0 + dr;
+        const double shell = 4. / 3. * M_PI * (r1*r1*r1 - r0*r0*r0);
+        const double ideal = (double) T * shell / volume;
+        rdf->r[b] = r0 + 0.5 * dr;
+
+        uint64_t total = 0;
+        for (int64_t a = 0; a < num_types; a++) {
+            for (int64_t c = a; c < num_types; c++) {
+                const uint64_t n = hist[(a * num_types + c) * num_bins + b];
+                total += n;
+                if (!by_type) continue;
+                const double pairs = (a == c) ? 0.5 * (double) counts[a] * (double) (counts[a] - 1)
+                                              : (double) counts[a] * (double) counts[c];
+                const double g = pairs > 0. ? (double) n / (pairs * ideal) : 0.;
+                rdf->g_pairs[(a * num_types + c) * num_bins + b] = g;
+                rdf->g_pairs[(c * num_types + a) * num_bins + b] = g;
+            }
+        }
+        rdf->g[b] = total_pairs > 0. ? (double) total / (total_pairs * ideal) : 0.;
+    }
+    if (by_type) rdf->num_types = num_types;
+
+    free(counts);
+    free(hist);
+    return 0;
+}
+
+void freeLAMMPSRdf(LAMMPSRdf* rdf) {
+    free(rdf->r);
+    free(rdf->g);
+    free(rdf->g_pairs);
+    rdf->r = NULL;
+    rdf->g = NULL;
+    rdf->g_pairs = NULL;
+}
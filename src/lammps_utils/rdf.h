@@ -0,0 +1,51 @@
+// rdf.h
+// Radial distribution function g(r) of a LAMMPSData trajectory, total and resolved by atom type.
+//
+#pragma once
+
+#include <stdint.h>
+
+#include "parser.h"
+
+/**
+ * @struct LAMMPSRdf
+ * @brief Histogrammed g(r) averaged over the frames of a trajectory
+ * @param num_bins Number of bins between 0 and r_max
+ * @param r_max Cutoff of the histogram
+ * @param dr Bin width
+ * @param num_types One more than the largest atom type (0 if g_pairs was not computed)
+ * @param num_frames Number of frames in the average
+ * @param r Centre of each bin
+ * @param g Total g(r), num_bins values
+ * @param g_pairs g_ab(r) of types a and b at g_pairs[(a*num_types + b)*num_bins + bin], symmetric in a and b.
+ *        Pairs of types without atoms are left at zero. NULL if not requested
+ */
+typedef struct LAMMPSRdf {
+    int64_t num_bins;
+    double r_max;
+    double dr;
+    int64_t num_types;
+    int64_t num_frames;
+    double* r;
+    double* g;
+    double* g_pairs;
+} LAMMPSRdf;
+
+/**
+ * @brief Compute g(r) up to `r_max` for every frame of `data` and average them.
+ * Pairs are found with the cell list of gg_math (neighbours.h), of side >= r_max, in the orthogonal
+ * periodic box of `data`, so each frame costs O(N) for a fixed density. Frames are distributed over OpenMP threads,
+ * each with its own cell list and histograms, merged at the end.
+ * @param r_max Cutoff, at most half of the shortest box side
+ * @param by_type If non zero, also compute g_ab(r) for every pair of atom types (needs `atomTypes`)
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ * @return 0 on success, -1 on failure
+ */
+int computeLAMMPSRdf(const LAMMPSData* data, const double r_max, const int64_t num_bins, const int by_type,
+                     const int num_threads, LAMMPSRdf* rdf);
+
+/**
+ * @brief Free the arrays of a LAMMPSRdf
+ * @warning does NOT free the struct itself
+ */
+void freeLAMMPSRdf(LAMMPSRdf* rdf);
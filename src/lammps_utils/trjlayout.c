@@ -0,0 +1,85 @@
+// trjlayout.c
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "trjlayout.h"
+
+// Tile of the transpose: TILE_FRAMES x TILE_ATOMS positions (about 24 KiB) are read and written
+#define TILE_FRAMES 32
+#define TILE_ATOMS  32
+
+int transposeLAMMPSData(const LAMMPSData* data, LAMMPSAtomMajor* am, LAMMPSLayout layout, const int num_threads) {
+    const int64_t N = data->num_atoms;
+    const int64_t T = data->num_timesteps;
+    const size_t len = (size_t) (N * T);
+
+    am->num_atoms = N;
+    am->num_timesteps = T;
+    am->layout = layout;
+    am->coordinates = NULL;
+    am->x = NULL;
+    am->y = NULL;
+    am->z = NULL;
+
+    if (!data->coordinates) {
+        fprintf(stderr, "Error: No coordinates to transpose.\n");
+        return -1;
+    }
+    if (layout == LAMMPS_ATOM_MAJOR) {
+        am->coordinates = malloc((len > 0 ? 3 * len : 1) * sizeof(double));
+    } else {
+        am->x = malloc((len > 0 ? len : 1) * sizeof(double));
+        am->y = malloc((len > 0 ? len : 1) * sizeof(double));
+        am->z = malloc((len > 0 ? len : 1) * sizeof(double));
+    }
+    if ((layout == LAMMPS_ATOM_MAJOR && !am->coordinates)
+        || (layout == LAMMPS_ATOM_MAJOR_SOA && (!am->x || !am->y || !am->z))) {
+        fprintf(stderr, "Error: Memory allocation failed for %ld frames of %ld atoms.\n", T, N);
+        freeLAMMPSAtomMajor(am);
+        return -1;
+    }
+
+    const double* src = data->coordinates;
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    for (int64_t t0 = 0; t0 < T; t0 += TILE_FRAMES) {
+        for (int64_t i0 = 0; i0 < N; i0 += TILE_ATOMS) {
+            const int64_t t1 = (t0 + TILE_FRAMES < T) ? t0 + TILE_FRAMES : T;
+            const int64_t i1 = (i0 + TILE_ATOMS < N) ? i0 + TILE_ATOMS : N;
+            for (int64_t i = i0; i < i1; i++) {
+                if (layout == LAMMPS_ATOM_MAJOR) {
+                    double* dst = am->coordinates + 3*i*T;
+                    for (int64_t t = t0; t < t1; t++) {
+                        dst[3*t]   = src[3*(t*N + i)];
+                        dst[3*t+1] = src[3*(t*N + i)+1];
+                        dst[3*t+2] = src[3*(t*N + i)+2];
+                    }
+                } else {
+                    double* x = am->x + i*T;
+                    double* y = am->y + i*T;
+                    double* z = am->z + i*T;
+                    for (int64_t t = t0; t < t1; t++) {
+                        x[t] = src[3*(t*N + i)];
+                        y[t] = src[3*(t*N + i)+1];
+                        z[t] = src[3*(t*N + i)+2];
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void freeLAMMPSAtomMajor(LAMMPSAtomMajor* am) {
+    free(am->coordinates);
+    free(am->x);
+    free(am->y);
+    free(am->z);
+    am->coordinates = NULL;
+    am->x = NULL;
+    am->y = NULL;
+    am->z = NULL;
+    am->num_atoms = 0;
+    am->num_timesteps = 0;
+}
@@ -0,0 +1,58 @@
+// trjlayout.h
+// Atom-major copies of a LAMMPSData trajectory for time-correlation analyses.
+//
+#pragma once
+
+#include <stdint.h>
+
+#include "parser.h"
+
+/**
+ * @brief Memory layout of a LAMMPSAtomMajor
+ */
+typedef enum LAMMPSLayout {
+    LAMMPS_ATOM_MAJOR,      ///< x, y, z interleaved: the T x 3 trajectory of each atom is contiguous
+    LAMMPS_ATOM_MAJOR_SOA   ///< Separate x, y and z arrays: the T values of each atom are contiguous
+} LAMMPSLayout;
+
+/**
+ * @struct LAMMPSAtomMajor
+ * @brief Coordinates of a LAMMPSData stored atom by atom instead of frame by frame
+ * @param num_atoms Number of atoms, in the order of `LAMMPSData.atomIds`
+ * @param num_timesteps Number of frames
+ * @param layout Which of the arrays below are set
+ * @param coordinates LAMMPS_ATOM_MAJOR: atom i at frame t is at coordinates[3*(i*num_timesteps + t)]
+ * @param x, y, z LAMMPS_ATOM_MAJOR_SOA: atom i at frame t is at x[i*num_timesteps + t]
+ */
+typedef struct LAMMPSAtomMajor {
+    int64_t num_atoms;
+    int64_t num_timesteps;
+    LAMMPSLayout layout;
+    double* coordinates;
+    double* x;
+    double* y;
+    double* z;
+} LAMMPSAtomMajor;
+
+/**
+ * @brief Transpose the frame-major coordinates of `data` into an atom-major copy.
+ * The copy is done in tiles of frames x atoms, so both the reads and the writes stay in cache,
+ * and tiles are spread over OpenMP threads.
+ * @param num_threads Number of OpenMP threads (<= 0 to use the OpenMP default)
+ * @return 0 on success, -1 on failure
+ */
+int transposeLAMMPSData(const LAMMPSData* data, LAMMPSAtomMajor* am, LAMMPSLayout layout, const int num_threads);
+
+/**
+ * @brief Trajectory of the atom in `slot` (LAMMPS_ATOM_MAJOR layout), in the T x 3 format
+ * expected by `compute_time_averaged_msd`. No copy is made.
+ */
+static inline const double* atomMajorTrajectory(const LAMMPSAtomMajor* am, const int64_t slot) {
+    return am->coordinates + 3 * slot * am->num_timesteps;
+}
+
+/**
+ * @brief Free the arrays of a LAMMPSAtomMajor
+ * @warning does NOT free the struct itself
+ */
+void freeLAMMPSAtomMajor(LAMMPSAtomMajor* am);
@@ -0,0 +1,246 @@
+// trjstream.c
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dumpframe.h"
+#include "dumpscan.h"
+#include "trjstream.h"
+
+#define LAMMPS_STREAM_BUFFER_SIZE (1 << 20)
+#define LAMMPS_STREAM_LINE_SIZE   4096
+
+struct LAMMPSStream {
+    FILE* file;
+    int64_t size;                        // Size of the dump
+    char* buffer;                        // stdio buffer
+    DumpColumnMap columns;               // Column map of the current frame
+    DumpSlotStamps stamps;               // Slots filled by readLAMMPSFrameAtomsById, one generation per frame
+    const DumpIdMap* stamps_ids;         // Table the stamps were built for
+    int64_t stamps_slots;                // Its number of slots at that time
+    char line[LAMMPS_STREAM_LINE_SIZE];
+};
+
+LAMMPSStream* openLAMMPSStream(const char* filename) {
+    LAMMPSStream* stream = malloc(sizeof(LAMMPSStream));
+    if (!stream) {
+        fprintf(stderr, "Error: Memory allocation failed in openLAMMPSStream.\n");
+        return NULL;
+    }
+
+    stream->file = fopen(filename, "r");
+    if (!stream->file) {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        free(stream);
+        return NULL;
+    }
+
+    stream->stamps = (DumpSlotStamps) {NULL, 0};
+    stream->stamps_ids = NULL;
+    stream->stamps_slots = 0;
+
+    fseek(stream->file, 0, SEEK_END);
+    stream->size = (int64_t) ftell(stream->file);
+    rewind(stream->file);
+
+    // Large reads: the dump is consumed front to back
+    stream->buffer = malloc(LAMMPS_STREAM_BUFFER_SIZE);
+    if (stream->buffer) {
+        setvbuf(stream->file, stream->buffer, _IOFBF, LAMMPS_STREAM_BUFFER_SIZE);
+    }
+    return stream;
+}
+
+void closeLAMMPSStream(LAMMPSStream* stream) {
+    if (!stream) return;
+    fclose(stream->file);
+    free(stream->buffer);
+    freeDumpSlotStamps(&stream->stamps);
+    free(stream);
+}
+
+int64_t tellLAMMPSStream(LAMMPSStream* stream) {
+    return (int64_t) ftell(stream->file);
+}
+
+int64_t sizeLAMMPSStream(const LAMMPSStream* stream) {
+    return stream->size;
+}
+
+void initLAMMPSFrame(LAMMPSFrame* frame) {
+    frame->timestep = 0;
+    frame->num_atoms = 0;
+    for (int d = 0; d < 6; d++) frame->box[d] = 0.;
+    frame->coordinates = NULL;
+    frame->atomIds = NULL;
+    frame->capacity = 0;
+    frame->external_coordinates = 0;
+}
+
+void initLAMMPSFrameWithBuffer(LAMMPSFrame* frame, double* coordinates, size_t capacity) {
+    initLAMMPSFrame(frame);
+    frame->coordinates = coordinates;
+    frame->capacity = capacity;
+    frame->external_coordinates = 1;
+}
+
+void freeLAMMPSFrame(LAMMPSFrame* frame) {
+    if (!frame->external_coordinates) {
+        free(frame->coordinates);
+    }
+    free(frame->atomIds);
+    initLAMMPSFrame(frame);
+}
+
+int readLAMMPSFrameHeader(LAMMPSStream* stream, LAMMPSFrame* frame) {
+    char* line = stream->line;
+    int has_timestep = 0;
+
+    frame->num_atoms = -1;
+    while (fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) {
+        const char* p;
+
+        if (strncmp(line, "ITEM: TIMESTEP", 14) == 0) {
+            if (!fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) break;
+            p = line;
+            frame->timestep = dumpScanInt64(&p, line + strlen(line));
+            has_timestep = 1;
+        }
+        else if (strncmp(line, "ITEM: NUMBER OF ATOMS", 21) == 0) {
+            if (!fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) break;
+            p = line;
+            frame->num_atoms = dumpScanInt64(&p, line + strlen(line));
+        }
+        else if (strncmp(line, "ITEM: BOX BOUNDS", 16) == 0) {
+            for (int d = 0; d < 3; d++) {
+                if (!fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) break;
+                const char* end = line + strlen(line);
+                p = line;
+                frame->box[2*d]   = dumpScanDouble(&p, end);
+                frame->box[2*d+1] = dumpScanDouble(&p, end);
+            }
+        }
+        else if (strncmp(line, "ITEM: ATOMS", 11) == 0) {
+            if (!has_timestep || frame->num_atoms < 0) {
+                fprintf(stderr, "Error: ITEM: ATOMS found before the frame header.\n");
+                return -1;
+            }
+            // Extra columns (velocities, forces, ...) are skipped
+            if (buildDumpColumnMap(line + 11, line + strlen(line), NULL, &stream->columns) != 0) {
+                return -1;
+            }
+            return 1;
+        }
+    }
+
+    if (has_timestep) {
+        fprintf(stderr, "Error: Truncated frame header at timestep %ld.\n", frame->timestep);
+        return -1;
+    }
+    return 0;
+}
+
+int readLAMMPSFrameAtoms(LAMMPSStream* stream, int64_t num_atoms,
+                         double* coordinates, int64_t* atomIds, int64_t* moleculeIds, int64_t* atomTypes) {
+    char* line = stream->line;
+    for (int64_t i = 0; i < num_atoms; i++) {
+        if (!fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) {
+            fprintf(stderr, "Error: Truncated frame.\n");
+            return -1;
+        }
+        const char* end = line + strlen(line);
+        parseDumpAtoms(line, end, 1, &stream->columns,
+                       coordinates ? coordinates + 3*i : NULL,
+                       atomIds     ? atomIds + i       : NULL,
+                       moleculeIds ? moleculeIds + i   : NULL,
+                       atomTypes   ? atomTypes + i     : NULL, NULL);
+    }
+    return 0;
+}
+
+int readLAMMPSFrameAtomsById(LAMMPSStream* stream, int64_t num_atoms, const DumpIdMap* ids, double* coordinates) {
+    char* line = stream->line;
+    int64_t num_stored = 0;
+    DumpSlotStamps* stamps = &stream->stamps;
+    // The stamps are built on the first frame and kept: each frame only advances the generation
+    if (stream->stamps_ids != ids || stream->stamps_slots != ids->num_slots) {
+        freeDumpSlotStamps(stamps);
+        stream->stamps_ids = NULL;
+        if (initDumpSlotStamps(ids, stamps) != 0) {
+            return -1;
+        }
+        stream->stamps_ids = ids;
+        stream->stamps_slots = ids->num_slots;
+    } else {
+        stamps->generation++;
+    }
+    int status = 0;
+    for (int64_t i = 0; i < num_atoms && status == 0; i++) {
+        int64_t found;
+        if (!fgets(line, LAMMPS_STREAM_LINE_SIZE, stream->file)) {
+            fprintf(stderr, "Error: Truncated frame.\n");
+            status = -1;
+        } else if (!parseDumpAtomsById(line, line + strlen(line), 1, &stream->columns, ids, stamps, coordinates,
+                                       NULL, NULL, NULL, &found)) {
+            status = -1;
+        } else {
+            num_stored += found;
+        }
+    }
+    if (status == 0 && num_stored != ids->num_slots) {
+        fprintf(stderr, "Error: Only %ld of %ld atoms found in the frame.\n", num_stored, ids->num_slots);
+        status = -1;
+    }
+    return status;
+}
+
+int skipLAMMPSFrameAtoms(LAMMPSStream* stream, int64_t num_atoms) {
+    for (int64_t i = 0; i < num_atoms; i++) {
+        if (!fgets(stream->line, LAMMPS_STREAM_LINE_SIZE, stream->file)) {
+            fprintf(stderr, "Error: Truncated frame.\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int nextLAMMPSFrame(LAMMPSStream* stream, LAMMPSFrame* frame) {
+    const int status = readLAMMPSFrameHeader(stream, frame);
+    if (status != 1) {
+        return status;
+    }
+
+    // Grow the buffers only when a frame is larger than any seen so far
+    const size_t num_atoms = (size_t) frame->num_atoms;
+    if (num_atoms > frame->capacity || !frame->atomIds) {
+        if (frame->external_coordinates && num_atoms > frame->capacity) {
+            fprintf(stderr, "Error: Frame at timestep %ld has %ld atoms, the buffer holds %zu.\n",
+                    frame->timestep, frame->num_atoms, frame->capacity);
+            return -1;
+        }
+        const size_t capacity = (num_atoms > frame->capacity) ? num_atoms : frame->capacity;
+
+        int64_t* atomIds = realloc(frame->atomIds, capacity * sizeof(int64_t));
+        if (!atomIds) {
+            fprintf(stderr, "Error: Memory allocation failed for %zu atoms.\n", capacity);
+            return -1;
+        }
+        frame->atomIds = atomIds;
+
+        if (!frame->external_coordinates) {
+            double* coordinates = realloc(frame->coordinates, 3 * capacity * sizeof(double));
+            if (!coordinates) {
+                fprintf(stderr, "Error: Memory allocation failed for %zu atoms.\n", capacity);
+                return -1;
+            }
+            frame->coordinates = coordinates;
+        }
+        frame->capacity = capacity;
+    }
+
+    if (readLAMMPSFrameAtoms(stream, frame->num_atoms, frame->coordinates, frame->atomIds, NULL, NULL) != 0) {
+        return -1;
+    }
+    return 1;
+}
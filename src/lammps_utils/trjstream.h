@@ -0,0 +1,127 @@
+// trjstream.h
+// Read a LAMMPS dump one frame at a time with bounded memory.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dumpframe.h"
+
+/**
+ * @struct LAMMPSFrame
+ * @brief A single frame of a dump
+ * @param timestep Timestep of the frame
+ * @param num_atoms Number of atoms in the frame
+ * @param box Box bounds as {xlo, xhi, ylo, yhi, zlo, zhi}
+ * @param coordinates x, y, z of each atom (3*num_atoms doubles)
+ * @param atomIds Id of each atom
+ * @param capacity Number of atoms the buffers can hold
+ * @param external_coordinates 1 if `coordinates` is owned by the caller
+ */
+typedef struct LAMMPSFrame {
+    int64_t timestep;
+    int64_t num_atoms;
+    double box[6];
+    double* coordinates;
+    int64_t* atomIds;
+    size_t capacity;
+    int external_coordinates;
+} LAMMPSFrame;
+
+/**
+ * @struct LAMMPSStream
+ * @brief An open dump read front to back
+ * @remark Opaque: use the functions below
+ */
+typedef struct LAMMPSStream LAMMPSStream;
+
+/**
+ * @brief Open a dump for streaming
+ * @return Pointer to the stream, NULL on failure
+ */
+LAMMPSStream* openLAMMPSStream(const char* filename);
+
+/**
+ * @brief Close the stream and free its memory
+ */
+void closeLAMMPSStream(LAMMPSStream* stream);
+
+/**
+ * @brief Number of bytes of the dump consumed so far
+ */
+int64_t tellLAMMPSStream(LAMMPSStream* stream);
+
+/**
+ * @brief Size of the dump in bytes
+ */
+int64_t sizeLAMMPSStream(const LAMMPSStream* stream);
+
+/**
+ * @brief Prepare a frame whose buffers are allocated, and recycled, by the stream
+ */
+void initLAMMPSFrame(LAMMPSFrame* frame);
+
+/**
+ * @brief Prepare a frame that reads coordinates into a caller-owned buffer
+ * @param coordinates Buffer of 3*capacity doubles
+ * @param capacity Maximum number of atoms per frame
+ * @warning Reading a frame with more than `capacity` atoms fails
+ */
+void initLAMMPSFrameWithBuffer(LAMMPSFrame* frame, double* coordinates, size_t capacity);
+
+/**
+ * @brief Free the buffers owned by the frame
+ * @warning does NOT free the struct itself nor a caller-owned coordinates buffer
+ */
+void freeLAMMPSFrame(LAMMPSFrame* frame);
+
+/**
+ * @brief Read the next frame, reusing the buffers of `frame`
+ * @return 1 if a frame was read, 0 at the end of the dump, -1 on failure
+ *
+ * Memory stays flat whatever the length of the dump, e.g.
+ * @code
+ * LAMMPSFrame frame;
+ * initLAMMPSFrame(&frame);
+ * while (nextLAMMPSFrame(stream, &frame) == 1) {
+ *     compute_CoM(frame.coordinates, frame.num_atoms, com);
+ * }
+ * freeLAMMPSFrame(&frame);
+ * @endcode
+ */
+int nextLAMMPSFrame(LAMMPSStream* stream, LAMMPSFrame* frame);
+
+/**
+ * @brief Read only the header of the next frame (timestep, number of atoms, box).
+ * Must be followed by `readLAMMPSFrameAtoms` or `skipLAMMPSFrameAtoms`.
+ * @return 1 if a header was read, 0 at the end of the dump, -1 on failure
+ */
+int readLAMMPSFrameHeader(LAMMPSStream* stream, LAMMPSFrame* frame);
+
+/**
+ * @brief Read the atom lines of the frame whose header was just read.
+ * The `id mol type xu yu zu` columns are located through the ATOMS header, any other column is skipped.
+ * @param coordinates Where to store x, y, z of each atom (NULL to ignore)
+ * @param atomIds, moleculeIds, atomTypes Where to store the integer columns (NULL to ignore)
+ * @return 0 on success, -1 on failure
+ */
+int readLAMMPSFrameAtoms(LAMMPSStream* stream, int64_t num_atoms,
+                         double* coordinates, int64_t* atomIds, int64_t* moleculeIds, int64_t* atomTypes);
+
+/**
+ * @brief Read the atom lines of the frame whose header was just read, storing each atom in the slot
+ * of its id. Handles dumps whose atom order changes from frame to frame (multi-rank runs).
+ * The stream keeps one stamp per slot to catch ids repeated within a frame; they are allocated on
+ * the first call and reused while the same `ids` is passed.
+ * @param ids Slot of each atom id, e.g. built by `buildDumpIdMap` from the ids of the first frame
+ * @param coordinates Where to store x, y, z of each slot
+ * @return 0 on success, -1 on failure (including atoms of `ids` missing from the frame)
+ */
+int readLAMMPSFrameAtomsById(LAMMPSStream* stream, int64_t num_atoms, const DumpIdMap* ids, double* coordinates);
+
+/**
+ * @brief Skip the atom lines of the frame whose header was just read, without converting them
+ * @return 0 on success, -1 on failure
+ */
+int skipLAMMPSFrameAtoms(LAMMPSStream* stream, int64_t num_atoms);
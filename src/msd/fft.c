@@ -0,0 +1,82 @@
+// fft.c
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fft.h"
+
+int64_t fft_size(const int64_t n) {
+    int64_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+int fft_radix2(double* re, double* im, const int64_t n, const int inverse) {
+    if (n < 1 || (n & (n - 1)) != 0) {
+        fprintf(stderr, "Error: FFT length %ld is not a power of two.\n", n);
+        return -1;
+    }
+    if (n == 1) {
+        return 0;
+    }
+
+    // Twiddles exp(-+2 pi i k / n), computed directly (no recurrence) to keep them exact to rounding
+    const int64_t half = n / 2;
+    double* tw_re = malloc(half * sizeof(double));
+    double* tw_im = malloc(half * sizeof(double));
+    if (!tw_re || !tw_im) {
+        fprintf(stderr, "Error: Memory allocation failed for an FFT of length %ld.\n", n);
+        free(tw_re);
+        free(tw_im);
+        return -1;
+    }
+    const double sign = inverse ? 1. : -1.;
+    for (int64_t k = 0; k < half; k++) {
+        const double angle = 2. * M_PI * (double) k / (double) n;
+        tw_re[k] = cos(angle);
+        tw_im[k] = sign * sin(angle);
+    }
+
+    // Bit-reversal permutation
+    for (int64_t i = 1, j = 0; i < n; i++) {
+        int64_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+            tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+        }
+    }
+
+    // Iterative butterflies: a stage of length `len` uses every (n/len)-th twiddle
+    for (int64_t len = 2; len <= n; len <<= 1) {
+        const int64_t half_len = len / 2;
+        const int64_t stride = n / len;
+        for (int64_t start = 0; start < n; start += len) {
+            for (int64_t k = 0; k < half_len; k++) {
+                const double wr = tw_re[k * stride];
+                const double wi = tw_im[k * stride];
+                const int64_t a = start + k;
+                const int64_t b = a + half_len;
+                const double br = re[b] * wr - im[b] * wi;
+                const double bi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - br;
+                im[b] = im[a] - bi;
+                re[a] += br;
+                im[a] += bi;
+            }
+        }
+    }
+
+    if (inverse) {
+        const double scale = 1. / (double) n;
+        for (int64_t i = 0; i < n; i++) {
+            re[i] *= scale;
+            im[i] *= scale;
+        }
+    }
+    free(tw_re);
+    free(tw_im);
+    return 0;
+}
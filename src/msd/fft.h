@@ -0,0 +1,20 @@
+// fft.h
+// Minimal radix-2 complex FFT used by the MSD routines.
+//
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Smallest power of two >= n
+ */
+int64_t fft_size(const int64_t n);
+
+/**
+ * @brief In-place complex FFT of length `n` (a power of two), with separate real and imaginary arrays.
+ * The forward transform is X_k = sum_j x_j exp(-2 pi i j k / n); the inverse uses the opposite sign
+ * and divides by `n`, so a forward and an inverse transform give back the input.
+ * @param inverse 0 for the forward transform, 1 for the inverse
+ * @return 0 on success, -1 if `n` is not a power of two or the twiddle table cannot be allocated
+ */
+int fft_radix2(double* re, double* im, const int64_t n, const int inverse);
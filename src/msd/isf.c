@@ -0,0 +1,179 @@
+// isf.c
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "isf.h"
+#include "msd.h"
+
+// Atoms per task of `compute_self_isf`; their displacements are gathered in small SoA arrays
+#define ISF_BLOCK 64
+
+/**
+ * @brief cos(x) for |x| < 2^50, branch-free so that loops calling it vectorise.
+ * x is folded to y in [-pi, pi] (rounding with the 1.5*2^52 trick instead of a libm call), where
+ * the Taylor polynomial of degree 22 in y is accurate to ~1e-12 without any further case split.
+ */
+#pragma omp declare simd
+static inline double isf_cos(const double x) {
+    const double two_pi = 6.28318530717958647692;
+    const double inv_two_pi = 0.15915494309189533577;
+    const double round_magic = 6755399441055744.0;
+
+    const double turns = (x * inv_two_pi + round_magic) - round_magic;
+    const double y = x - turns * two_pi;
+    const double y2 = y * y;
+
+    // (-1)^n / (2n)! for n = 11 ... 0
+    double p = -1.0 / 1124000727777607680000.0;
+    p = p * y2 + 1.0 / 2432902008176640000.0;
+    p = p * y2 - 1.0 / 6402373705728000.0;
+    p = p * y2 + 1.0 / 20922789888000.0;
+    p = p * y2 - 1.0 / 87178291200.0;
+    p = p * y2 + 1.0 / 479001600.0;
+    p = p * y2 - 1.0 / 3628800.0;
+    p = p * y2 + 1.0 / 40320.0;
+    p = p * y2 - 1.0 / 720.0;
+    p = p * y2 + 1.0 / 24.0;
+    p = p * y2 - 0.5;
+    return p * y2 + 1.0;
+}
+
+int64_t generate_k_vectors(const double k, const double dk, const double* box_lengths,
+                           const int64_t max_vectors, double* kvecs) {
+    const double k_min = k - 0.5 * dk;
+    const double k_max = k + 0.5 * dk;
+    if (!(k_max > 0.0) || max_vectors <= 0) {
+        return 0;
+    }
+    double unit[3];
+    int64_t n_max[3];
+    for (int d = 0; d < 3; d++) {
+        unit[d] = 2.0 * M_PI / box_lengths[d];
+        n_max[d] = (int64_t) ceil(k_max / unit[d]);
+    }
+
+    // First pass counts the candidates, the second keeps an evenly spaced subset
+    int64_t num_candidates = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        int64_t seen = 0, written = 0;
+        for (int64_t nz = 0; nz <= n_max[2]; nz++) {
+            for (int64_t ny = (nz == 0 ? 0 : -n_max[1]); ny <= n_max[1]; ny++) {
+                for (int64_t nx = (nz == 0 && ny == 0 ? 1 : -n_max[0]); nx <= n_max[0]; nx++) {
+                    const double kx = nx * unit[0];
+                    const double ky = ny * unit[1];
+                    const double kz = nz * unit[2];
+                    const double modulus = sqrt(kx*kx + ky*ky + kz*kz);
+                    if (modulus < k_min || modulus > k_max) continue;
+                    if (pass == 1 && written < max_vectors
+                        && seen * max_vectors >= written * num_candidates) {
+                        kvecs[3*written]   = kx;
+                        kvecs[3*written+1] = ky;
+                        kvecs[3*written+2] = kz;
+                        written++;
+                    }
+                    seen++;
+                }
+            }
+        }
+        if (pass == 1) {
+            return written;
+        }
+        num_candidates = seen;
+    }
+    return 0;
+}
+
+double* compute_self_isf(const double* coordinates, const int64_t num_atoms,
+                         const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep,
+                         const double* kvecs, const int64_t num_k, const int num_threads) {
+    // Same windows as `compute_time_averaged_msd`
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, deltaTimestep);
+    const int64_t n_blocks = (num_atoms + ISF_BLOCK - 1) / ISF_BLOCK;
+
+    if (num_k <= 0) {
+        fprintf(stderr, "Error: No k-vectors for F_s(k,t).\n");
+        return NULL;
+    }
+    double* isf = (double*) calloc(total_n_windows, sizeof(double));
+    int64_t* window_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+    if (!isf || !window_counters) {
+        fprintf(stderr, "Failed to allocate memory for F_s(k,t)\n");
+        free(isf);
+        free(window_counters);
+        return NULL;
+    }
+
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        double* local_isf = (double*) calloc(total_n_windows, sizeof(double));
+        int64_t* local_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        const int ok = local_isf && local_counters;
+        if (!ok) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        double dx[ISF_BLOCK], dy[ISF_BLOCK], dz[ISF_BLOCK];
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for(int64_t b=0; b<n_blocks; b++) {
+            for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+                if (!ok) continue;
+                const int64_t first = b * ISF_BLOCK;
+                const int64_t n = (num_atoms - first < ISF_BLOCK) ? num_atoms - first : ISF_BLOCK;
+                const double* frame0 = coordinates + 3 * (t_start * num_atoms + first);
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    const int64_t idx_deltaTime = msd_lag_index(timesteps[t_start], timesteps[t_end], deltaTimestep);
+                    const double* frame1 = coordinates + 3 * (t_end * num_atoms + first);
+                    for(int64_t i=0; i<n; i++) {
+                        dx[i] = frame1[3*i]   - frame0[3*i];
+                        dy[i] = frame1[3*i+1] - frame0[3*i+1];
+                        dz[i] = frame1[3*i+2] - frame0[3*i+2];
+                    }
+                    double sum = 0.0;
+                    for(int64_t q=0; q<num_k; q++) {
+                        const double kx = kvecs[3*q];
+                        const double ky = kvecs[3*q+1];
+                        const double kz = kvecs[3*q+2];
+                        #pragma omp simd reduction(+:sum)
+                        for(int64_t i=0; i<n; i++) {
+                            sum += isf_cos(kx*dx[i] + ky*dy[i] + kz*dz[i]);
+                        }
+                    }
+                    local_isf[idx_deltaTime] += sum;
+                    local_counters[idx_deltaTime] += n * num_k;
+                }
+            }
+        }
+
+        if (ok) {
+            #pragma omp critical
+            {
+                for(int64_t t=0; t<total_n_windows; t++) {
+                    isf[t] += local_isf[t];
+                    window_counters[t] += local_counters[t];
+                }
+            }
+        }
+        free(local_isf);
+        free(local_counters);
+    }
+    if (failed) {
+        fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+        free(isf);
+        free(window_counters);
+        return NULL;
+    }
+
+    for(int64_t t=0; t<total_n_windows; t++) {
+        if (window_counters[t]!=0) {
+            isf[t] /= (double) window_counters[t];
+        }
+    }
+    isf[0] = 1.0;
+    free(window_counters);
+    return isf;
+}
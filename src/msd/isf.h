@@ -0,0 +1,33 @@
+// isf.h
+// Self intermediate scattering function F_s(k,t) of a trajectory.
+//
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Wave vectors of a periodic box with modulus in [k - dk/2, k + dk/2]
+ *
+ * The vectors are 2 pi (nx/Lx, ny/Ly, nz/Lz) with integer n. Only one of k and -k is kept, since
+ * F_s is even in k. If more than `max_vectors` qualify, an evenly spaced subset is returned.
+ * @param box_lengths Box sides Lx, Ly, Lz
+ * @param kvecs Where to store the vectors, at least 3*max_vectors values
+ * @return Number of vectors written
+ */
+int64_t generate_k_vectors(const double k, const double dk, const double* box_lengths,
+                           const int64_t max_vectors, double* kvecs);
+
+/**
+ * @brief F_s(k,t) = <cos(k . (r_i(t0+t) - r_i(t0)))> averaged over atoms, time origins and the given k-vectors
+ *
+ * Uses the same windows as `compute_time_averaged_msd`. The cosines are evaluated by a branch-free
+ * polynomial kernel vectorised over the atoms (absolute error below 1e-9), and the work is split in
+ * (block of atoms, time origin) tasks over OpenMP threads with private lag histograms.
+ * @param coordinates num_timesteps frames of num_atoms x 3 unwrapped coordinates (frame-major, as in LAMMPSData)
+ * @param kvecs num_k wave vectors (e.g. from `generate_k_vectors`), 3 values each
+ * @param num_threads Number of OpenMP threads (<= 0 for the OpenMP default)
+ * @return Array to free with F_s at each lag (F_s = 1 at lag 0), NULL on failure
+ */
+double* compute_self_isf(const double* coordinates, const int64_t num_atoms,
+                         const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep,
+                         const double* kvecs, const int64_t num_k, const int num_threads);
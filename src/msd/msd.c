@@ -3,13 +3,21 @@
 #include <math.h>
 #include <omp.h>
 
-double* compute_time_averaged_msd(const double* coordinates, const int64_t* timesteps, const int64_t num_timesteps, const int64_t timestep_difference) {
+#include "fft.h"
+#include "msd.h"
+
+int64_t count_msd_lags(const int64_t* timesteps, const int64_t num_timesteps, const int64_t timestep_difference) {
     // Number of windows must be computed with the formula in case timesteps are missing.
     // Having holes does not decrease the number of windows
     // Starting late does decrease the number of windows!
     // The maximum length possible is the last timestep divided by timestep_difference rounded up
     int64_t total_n_windows = (timesteps[num_timesteps-1] - timesteps[0] + timestep_difference - 1 ) / timestep_difference;
     total_n_windows+=1; // Zero length window. I expect it to be zero and compute that as a check
+    return total_n_windows;
+}
+
+double* compute_time_averaged_msd(const double* coordinates, const int64_t* timesteps, const int64_t num_timesteps, const int64_t timestep_difference) {
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
 
     double* ave_msd = (double*) calloc(total_n_windows, sizeof(double));
     if (!ave_msd) {
@@ -27,8 +35,7 @@ double* compute_time_averaged_msd(const double* coordinates, const int64_t* time
     for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
         #pragma omp parallel for
         for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
-            int64_t time_difference = timesteps[t_end]-timesteps[t_start];
-            int64_t idx_deltaTime = time_difference / timestep_difference; // [Assumption] Timesteps are all multiples of timestep_difference
+            const int64_t idx_deltaTime = msd_lag_index(timesteps[t_start], timesteps[t_end], timestep_difference);
 
             // Let's compute the MSD for the single particle
             const double dx = coordinates[3*t_end]   - coordinates[3*t_start];
@@ -55,6 +62,320 @@ double* compute_time_averaged_msd(const double* coordinates, const int64_t* time
 }
 
 
+double* compute_time_averaged_msd_xyz(const double* x, const double* y, const double* z,
+                                      const int64_t* timesteps, const int64_t num_timesteps, const int64_t timestep_difference) {
+    // Same windows as `compute_time_averaged_msd`
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
+
+    double* ave_msd = (double*) calloc(total_n_windows, sizeof(double));
+    int64_t* window_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+    if (!ave_msd || !window_counters) {
+        fprintf(stderr, "Failed to allocate memory for ave_msd\n");
+        exit(-1);
+    }
+
+    // Every thread accumulates its own windows, merged once at the end (no atomics in the inner loop)
+    #pragma omp parallel
+    {
+        double* local_msd = (double*) calloc(total_n_windows, sizeof(double));
+        int64_t* local_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        if (!local_msd || !local_counters) {
+            fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+            exit(-1);
+        }
+
+        #pragma omp for schedule(dynamic, 16)
+        for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+            const double x0 = x[t_start];
+            const double y0 = y[t_start];
+            const double z0 = z[t_start];
+            const int64_t time0 = timesteps[t_start];
+            for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                const int64_t idx_deltaTime = msd_lag_index(time0, timesteps[t_end], timestep_difference);
+                const double dx = x[t_end] - x0;
+                const double dy = y[t_end] - y0;
+                const double dz = z[t_end] - z0;
+                local_msd[idx_deltaTime] += dx*dx + dy*dy + dz*dz;
+                local_counters[idx_deltaTime] += 1;
+            }
+        }
+
+        #pragma omp critical
+        {
+            for(int64_t t=0; t<total_n_windows; t++) {
+                ave_msd[t] += local_msd[t];
+                window_counters[t] += local_counters[t];
+            }
+        }
+        free(local_msd);
+        free(local_counters);
+    }
+
+    for(int64_t t=0; t<total_n_windows; t++) {
+        if (window_counters[t]!=0) {
+            ave_msd[t] /= (double) window_counters[t];
+        }
+    }
+    free(window_counters);
+    return ave_msd;
+}
+
+
+double* compute_ensemble_time_averaged_msd(const double* coordinates, const int64_t num_atoms,
+                                           const int64_t* atom_slots, const int64_t num_selected,
+                                           const int64_t* timesteps, const int64_t num_timesteps,
+                                           const int64_t timestep_difference, const int num_threads) {
+    // Same windows as `compute_time_averaged_msd`, averaged over the selected atoms as well.
+    // The work is split in (block of atoms, time origin) tasks: every task walks the later frames
+    // once and adds the squared displacements of its block to a per-thread lag histogram, so
+    // threads never share a counter until the final reduction.
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
+
+    const int64_t n_particles = atom_slots ? num_selected : num_atoms;
+    const int64_t block = 256;
+    const int64_t n_blocks = (n_particles + block - 1) / block;
+
+    double* ave_msd = (double*) calloc(total_n_windows, sizeof(double));
+    int64_t* window_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+    if (!ave_msd || !window_counters) {
+        fprintf(stderr, "Failed to allocate memory for ave_msd\n");
+        exit(-1);
+    }
+
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        double* local_msd = (double*) calloc(total_n_windows, sizeof(double));
+        int64_t* local_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        if (!local_msd || !local_counters) {
+            fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+            exit(-1);
+        }
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for(int64_t b=0; b<n_blocks; b++) {
+            for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+                const int64_t first = b * block;
+                const int64_t last = (first + block < n_particles) ? first + block : n_particles;
+                const double* frame0 = coordinates + 3 * t_start * num_atoms;
+                const int64_t time0 = timesteps[t_start];
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    const int64_t idx_deltaTime = msd_lag_index(time0, timesteps[t_end], timestep_difference);
+                    const double* frame1 = coordinates + 3 * t_end * num_atoms;
+                    double msd = 0.;
+                    #pragma omp simd reduction(+:msd)
+                    for(int64_t p=first; p<last; p++) {
+                        const int64_t i = atom_slots ? atom_slots[p] : p;
+                        const double dx = frame1[3*i]   - frame0[3*i];
+                        const double dy = frame1[3*i+1] - frame0[3*i+1];
+                        const double dz = frame1[3*i+2] - frame0[3*i+2];
+                        msd += dx*dx + dy*dy + dz*dz;
+                    }
+                    local_msd[idx_deltaTime] += msd;
+                    local_counters[idx_deltaTime] += last - first;
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for(int64_t t=0; t<total_n_windows; t++) {
+                ave_msd[t] += local_msd[t];
+                window_counters[t] += local_counters[t];
+            }
+        }
+        free(local_msd);
+        free(local_counters);
+    }
+
+    for(int64_t t=0; t<total_n_windows; t++) {
+        if (window_counters[t]!=0) {
+            ave_msd[t] /= (double) window_counters[t];
+        }
+    }
+    free(window_counters);
+    return ave_msd;
+}
+
+
+double* compute_ensemble_time_averaged_msd_xyz(const double* x, const double* y, const double* z,
+                                               const int64_t num_atoms, const int64_t* atom_slots, const int64_t num_selected,
+                                               const int64_t* timesteps, const int64_t num_timesteps,
+                                               const int64_t timestep_difference, const int num_threads) {
+    // Same windows and (block of atoms, time origin) tasks as `compute_ensemble_time_averaged_msd`,
+    // on atom-major series. Within a task every atom adds its squared displacements to a row indexed
+    // by the end frame: series and row are both contiguous in the end frame, so the inner loop has
+    // unit stride. The row goes to the lag histogram once per block.
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
+
+    const int64_t n_particles = atom_slots ? num_selected : num_atoms;
+    const int64_t block = 64;
+    const int64_t n_blocks = (n_particles + block - 1) / block;
+
+    double* ave_msd = (double*) calloc(total_n_windows, sizeof(double));
+    int64_t* window_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+    if (!ave_msd || !window_counters) {
+        fprintf(stderr, "Failed to allocate memory for ave_msd\n");
+        exit(-1);
+    }
+
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        double* local_msd = (double*) calloc(total_n_windows, sizeof(double));
+        int64_t* local_counters = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        double* row = (double*) malloc(num_timesteps * sizeof(double));
+        if (!local_msd || !local_counters || !row) {
+            fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+            exit(-1);
+        }
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for(int64_t b=0; b<n_blocks; b++) {
+            for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+                const int64_t first = b * block;
+                const int64_t last = (first + block < n_particles) ? first + block : n_particles;
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    row[t_end] = 0.;
+                }
+                for(int64_t p=first; p<last; p++) {
+                    const int64_t i = atom_slots ? atom_slots[p] : p;
+                    const double* xi = x + i * num_timesteps;
+                    const double* yi = y + i * num_timesteps;
+                    const double* zi = z + i * num_timesteps;
+                    const double x0 = xi[t_start];
+                    const double y0 = yi[t_start];
+                    const double z0 = zi[t_start];
+                    #pragma omp simd
+                    for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                        const double dx = xi[t_end] - x0;
+                        const double dy = yi[t_end] - y0;
+                        const double dz = zi[t_end] - z0;
+                        row[t_end] += dx*dx + dy*dy + dz*dz;
+                    }
+                }
+                const int64_t time0 = timesteps[t_start];
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    const int64_t idx_deltaTime = msd_lag_index(time0, timesteps[t_end], timestep_difference);
+                    local_msd[idx_deltaTime] += row[t_end];
+                    local_counters[idx_deltaTime] += last - first;
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for(int64_t t=0; t<total_n_windows; t++) {
+                ave_msd[t] += local_msd[t];
+                window_counters[t] += local_counters[t];
+            }
+        }
+        free(local_msd);
+        free(local_counters);
+        free(row);
+    }
+
+    for(int64_t t=0; t<total_n_windows; t++) {
+        if (window_counters[t]!=0) {
+            ave_msd[t] /= (double) window_counters[t];
+        }
+    }
+    free(window_counters);
+    return ave_msd;
+}
+
+double* compute_time_averaged_msd_fft(const double* coordinates, const int64_t* timesteps, const int64_t num_timesteps, const int64_t timestep_difference) {
+    // Same windows as `compute_time_averaged_msd`, through the autocorrelation form of the MSD.
+    // Frames are placed on a regular grid of lags; m_k = 1 where a frame exists, 0 in the holes.
+    // For every lag l, with sums over the pairs (k, k+l) that both exist:
+    //   count(l) = sum m_k m_{k+l}
+    //   S(l)     = sum m_k m_{k+l} (|r_k|^2 + |r_{k+l}|^2)
+    //   C(l)     = sum m_k m_{k+l} r_k . r_{k+l}
+    //   MSD(l)   = (S(l) - 2 C(l)) / count(l)
+    // Each sum is a correlation, computed with zero padded FFTs in O(T log T).
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
+
+    double* ave_msd = (double*) calloc(total_n_windows, sizeof(double));
+    if (!ave_msd) {
+        fprintf(stderr, "Failed to allocate memory for ave_msd\n");
+        exit(-1);
+    }
+
+    // Padding to twice the grid keeps the circular correlations from wrapping around
+    const int64_t n = fft_size(2 * total_n_windows);
+    double* buffer = (double*) calloc(6 * n, sizeof(double));
+    if (!buffer) {
+        fprintf(stderr, "Failed to allocate memory for the FFT buffers\n");
+        exit(-1);
+    }
+    double* mq_re = buffer;          // m + i q, with q = m |r|^2
+    double* mq_im = buffer + n;
+    double* xy_re = buffer + 2*n;    // x + i y
+    double* xy_im = buffer + 3*n;
+    double* z_re  = buffer + 4*n;    // z
+    double* z_im  = buffer + 5*n;
+
+    // Positions relative to their mean: the MSD does not change and the cancellation in S - 2C is smaller
+    double mean[3] = {0., 0., 0.};
+    for(int64_t t=0; t<num_timesteps; t++) {
+        mean[0] += coordinates[3*t];
+        mean[1] += coordinates[3*t+1];
+        mean[2] += coordinates[3*t+2];
+    }
+    for(int d=0; d<3; d++) {
+        mean[d] /= (double) num_timesteps;
+    }
+    for(int64_t t=0; t<num_timesteps; t++) {
+        const int64_t k = msd_lag_index(timesteps[0], timesteps[t], timestep_difference);
+        const double x = coordinates[3*t]   - mean[0];
+        const double y = coordinates[3*t+1] - mean[1];
+        const double z = coordinates[3*t+2] - mean[2];
+        mq_re[k] = 1.;
+        mq_im[k] = x*x + y*y + z*z;
+        xy_re[k] = x;
+        xy_im[k] = y;
+        z_re[k]  = z;
+    }
+
+    if (fft_radix2(mq_re, mq_im, n, 0) || fft_radix2(xy_re, xy_im, n, 0) || fft_radix2(z_re, z_im, n, 0)) {
+        exit(-1);
+    }
+
+    // Split the packed spectra of the real sequences (A_k = (P_k + conj P_{-k}) / 2, B_k = (P_k - conj P_{-k}) / 2i)
+    // and form the spectra of the correlations, which are real:
+    //   count -> |M|^2,  S -> 2 Re(conj(M) Q),  C -> |X|^2 + |Y|^2 + |Z|^2
+    // count and S are packed back as real and imaginary part of a single inverse transform
+    for(int64_t k=0; k<=n/2; k++) {
+        const int64_t nk = (n - k) & (n - 1);
+        const double m_re = 0.5 * (mq_re[k] + mq_re[nk]);
+        const double m_im = 0.5 * (mq_im[k] - mq_im[nk]);
+        const double q_re = 0.5 * (mq_im[k] + mq_im[nk]);
+        const double q_im = -0.5 * (mq_re[k] - mq_re[nk]);
+        const double count_k = m_re*m_re + m_im*m_im;
+        const double s_k = 2. * (m_re*q_re + m_im*q_im);
+        const double c_k = 0.5 * (xy_re[k]*xy_re[k] + xy_im[k]*xy_im[k] + xy_re[nk]*xy_re[nk] + xy_im[nk]*xy_im[nk])
+                           + z_re[k]*z_re[k] + z_im[k]*z_im[k];
+        // The spectra are even in k, so both k and n-k get the same values
+        mq_re[k] = mq_re[nk] = count_k;
+        mq_im[k] = mq_im[nk] = s_k;
+        xy_re[k] = xy_re[nk] = c_k;
+        xy_im[k] = xy_im[nk] = 0.;
+    }
+
+    if (fft_radix2(mq_re, mq_im, n, 1) || fft_radix2(xy_re, xy_im, n, 1)) {
+        exit(-1);
+    }
+
+    // Lag 0 is left at zero, as in the reference
+    for(int64_t t=1; t<total_n_windows; t++) {
+        const double count = nearbyint(mq_re[t]);
+        if (count > 0.) {
+            ave_msd[t] = (mq_im[t] - 2. * xy_re[t]) / count;
+        }
+    }
+    free(buffer);
+    return ave_msd;
+}
+
+
 double compute_MSD(const double* coordinates1, const double* coordinates2, const int num_atoms) {
     // Computes the MSD averaged over all particles at a given timestep.
     // It assumes a linear array of coordinates with x, y, z for each atom.
@@ -71,4 +392,274 @@ double compute_MSD(const double* coordinates1, const double* coordinates2, const
         msd += dx*dx + dy*dy + dz*dz;
     }
     return msd / ( (double) num_atoms );
-}
\ No newline at end of file
+}
+
+
+// Particles handled per tile of `accumulate_displacements`: the squared displacements of a tile
+// stay in registers/L1 between the vectorised moments and the scalar histogram
+#define DISPLACEMENT_TILE 256
+
+void accumulate_displacements(const double* coordinates1, const double* coordinates2, const int64_t num_atoms,
+                              const double inv_dr, const int64_t num_bins,
+                              double* r2_sum, double* r4_sum, double* histogram) {
+    // One evaluation of every displacement feeds the three statistics:
+    //  r2_sum    += sum |dr|^2           (MSD)
+    //  r4_sum    += sum |dr|^4           (non-Gaussian parameter)
+    //  histogram[|dr| / dr] += 1         (self van Hove), displacements beyond num_bins bins are not counted
+    double d2[DISPLACEMENT_TILE];
+    double r2 = 0.0, r4 = 0.0;
+    for(int64_t first = 0; first < num_atoms; first += DISPLACEMENT_TILE) {
+        const int n = (num_atoms - first < DISPLACEMENT_TILE) ? (int) (num_atoms - first) : DISPLACEMENT_TILE;
+        const double* c1 = coordinates1 + 3*first;
+        const double* c2 = coordinates2 + 3*first;
+
+        #pragma omp simd reduction(+:r2, r4)
+        for(int i = 0; i < n; i++) {
+            const double dx = c2[3*i]   - c1[3*i];
+            const double dy = c2[3*i+1] - c1[3*i+1];
+            const double dz = c2[3*i+2] - c1[3*i+2];
+            const double s = dx*dx + dy*dy + dz*dz;
+            d2[i] = s;
+            r2 += s;
+            r4 += s*s;
+        }
+
+        if (!histogram) continue;
+        for(int i = 0; i < n; i++) {
+            const int64_t bin = (int64_t) (sqrt(d2[i]) * inv_dr);
+            if (bin < num_bins) histogram[bin] += 1.0;
+        }
+    }
+    *r2_sum += r2;
+    *r4_sum += r4;
+}
+
+// Windows and zeroed arrays of `stats`; alpha2 holds the sums of |dr|^4 until the normalisation
+static int init_displacement_statistics(const int64_t* timesteps, const int64_t num_timesteps,
+                                        const int64_t timestep_difference, const double r_max, const int64_t num_bins,
+                                        DisplacementStatistics* stats) {
+    const int64_t total_n_windows = count_msd_lags(timesteps, num_timesteps, timestep_difference);
+
+    stats->num_lags = total_n_windows;
+    stats->num_bins = num_bins;
+    stats->r_max = r_max;
+    stats->msd = NULL;
+    stats->alpha2 = NULL;
+    stats->van_hove = NULL;
+    stats->counts = NULL;
+    if (num_bins < 0 || (num_bins > 0 && !(r_max > 0.0))) {
+        fprintf(stderr, "Error: Invalid van Hove histogram, %ld bins up to %lf.\n", num_bins, r_max);
+        return -1;
+    }
+    const int64_t hist_len = total_n_windows * num_bins;
+    stats->msd = (double*) calloc(total_n_windows, sizeof(double));
+    stats->alpha2 = (double*) calloc(total_n_windows, sizeof(double));
+    stats->van_hove = (double*) calloc(hist_len > 0 ? hist_len : 1, sizeof(double));
+    stats->counts = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+    if (!stats->msd || !stats->alpha2 || !stats->van_hove || !stats->counts) {
+        fprintf(stderr, "Failed to allocate memory for the displacement statistics\n");
+        free_displacement_statistics(stats);
+        return -1;
+    }
+    return 0;
+}
+
+// Add the private sums of a thread to `stats`
+static void merge_displacement_statistics(const double* r2, const double* r4, const double* histogram,
+                                          const int64_t* counts, DisplacementStatistics* stats) {
+    #pragma omp critical
+    {
+        for(int64_t t=0; t<stats->num_lags; t++) {
+            stats->msd[t] += r2[t];
+            stats->alpha2[t] += r4[t];
+            stats->counts[t] += counts[t];
+        }
+        for(int64_t k=0; k<stats->num_lags * stats->num_bins; k++) {
+            stats->van_hove[k] += histogram[k];
+        }
+    }
+}
+
+// Turn the sums of |dr|^2, |dr|^4 and the histogram counts into MSD, alpha2 and G_s
+static void normalise_displacement_statistics(DisplacementStatistics* stats) {
+    const int64_t num_bins = stats->num_bins;
+    const double dr = num_bins > 0 ? stats->r_max / (double) num_bins : 0.0;
+    for(int64_t t=0; t<stats->num_lags; t++) {
+        if (stats->counts[t] == 0) continue;
+        const double n = (double) stats->counts[t];
+        const double r2_mean = stats->msd[t] / n;
+        const double r4_mean = stats->alpha2[t] / n;
+        stats->msd[t] = r2_mean;
+        stats->alpha2[t] = r2_mean > 0.0 ? 3.0 * r4_mean / (5.0 * r2_mean * r2_mean) - 1.0 : 0.0;
+        for(int64_t b=0; b<num_bins; b++) {
+            const double r0 = b * dr;
+            const double r1 = r0 + dr;
+            const double shell = 4.0 / 3.0 * M_PI * (r1*r1*r1 - r0*r0*r0);
+            stats->van_hove[t * num_bins + b] /= n * shell;
+        }
+    }
+}
+
+int compute_displacement_statistics(const double* coordinates, const int64_t num_atoms,
+                                    const int64_t* timesteps, const int64_t num_timesteps,
+                                    const int64_t timestep_difference, const double r_max, const int64_t num_bins,
+                                    const int num_threads, DisplacementStatistics* stats) {
+    // Same windows as `compute_time_averaged_msd`; every pair of frames is evaluated once by
+    // `accumulate_displacements`, with time origins spread over threads and private accumulators
+    if (init_displacement_statistics(timesteps, num_timesteps, timestep_difference, r_max, num_bins, stats) != 0) {
+        return -1;
+    }
+    const int64_t total_n_windows = stats->num_lags;
+    const int64_t hist_len = total_n_windows * num_bins;
+    const double inv_dr = num_bins > 0 ? (double) num_bins / r_max : 0.0;
+
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        double* local_r2 = (double*) calloc(total_n_windows, sizeof(double));
+        double* local_r4 = (double*) calloc(total_n_windows, sizeof(double));
+        double* local_hist = (double*) calloc(hist_len > 0 ? hist_len : 1, sizeof(double));
+        int64_t* local_counts = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        const int ok = local_r2 && local_r4 && local_hist && local_counts;
+        if (!ok) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic, 16)
+        for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+            if (!ok) continue;
+            const double* frame0 = coordinates + 3 * t_start * num_atoms;
+            for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                const int64_t idx_deltaTime = msd_lag_index(timesteps[t_start], timesteps[t_end], timestep_difference);
+                accumulate_displacements(frame0, coordinates + 3 * t_end * num_atoms, num_atoms,
+                                         inv_dr, num_bins, &local_r2[idx_deltaTime], &local_r4[idx_deltaTime],
+                                         num_bins > 0 ? local_hist + idx_deltaTime * num_bins : NULL);
+                local_counts[idx_deltaTime] += num_atoms;
+            }
+        }
+
+        if (ok) {
+            merge_displacement_statistics(local_r2, local_r4, local_hist, local_counts, stats);
+        }
+        free(local_r2);
+        free(local_r4);
+        free(local_hist);
+        free(local_counts);
+    }
+    if (failed) {
+        fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+        free_displacement_statistics(stats);
+        return -1;
+    }
+
+    normalise_displacement_statistics(stats);
+    return 0;
+}
+
+int compute_displacement_statistics_xyz(const double* x, const double* y, const double* z, const int64_t num_atoms,
+                                        const int64_t* timesteps, const int64_t num_timesteps,
+                                        const int64_t timestep_difference, const double r_max, const int64_t num_bins,
+                                        const int num_threads, DisplacementStatistics* stats) {
+    // Same statistics as `compute_displacement_statistics`, from atom-major series. Tasks are
+    // (block of atoms, time origin): the moments of every atom are added to rows indexed by the end
+    // frame with unit stride, and go to the lag accumulators once per block; the histogram is
+    // filled from the squared displacements of the atom, kept in a row as well
+    if (init_displacement_statistics(timesteps, num_timesteps, timestep_difference, r_max, num_bins, stats) != 0) {
+        return -1;
+    }
+    const int64_t total_n_windows = stats->num_lags;
+    const int64_t hist_len = total_n_windows * num_bins;
+    const double inv_dr = num_bins > 0 ? (double) num_bins / r_max : 0.0;
+    const int64_t n_blocks = (num_atoms + DISPLACEMENT_TILE - 1) / DISPLACEMENT_TILE;
+
+    int failed = 0;
+    #pragma omp parallel num_threads(num_threads > 0 ? num_threads : omp_get_max_threads())
+    {
+        double* local_r2 = (double*) calloc(total_n_windows, sizeof(double));
+        double* local_r4 = (double*) calloc(total_n_windows, sizeof(double));
+        double* local_hist = (double*) calloc(hist_len > 0 ? hist_len : 1, sizeof(double));
+        int64_t* local_counts = (int64_t*) calloc(total_n_windows, sizeof(int64_t));
+        double* rows = (double*) malloc(3 * num_timesteps * sizeof(double));
+        int64_t* lags = (int64_t*) malloc(num_timesteps * sizeof(int64_t));
+        const int ok = local_r2 && local_r4 && local_hist && local_counts && rows && lags;
+        if (!ok) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        double* row_r2 = rows;
+        double* row_r4 = rows + num_timesteps;
+        double* d2 = rows + 2 * num_timesteps;
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for(int64_t b=0; b<n_blocks; b++) {
+            for(int64_t t_start=0; t_start<num_timesteps; t_start++) {
+                if (!ok) continue;
+                const int64_t first = b * DISPLACEMENT_TILE;
+                const int64_t last = (first + DISPLACEMENT_TILE < num_atoms) ? first + DISPLACEMENT_TILE : num_atoms;
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    lags[t_end] = msd_lag_index(timesteps[t_start], timesteps[t_end], timestep_difference);
+                    row_r2[t_end] = 0.0;
+                    row_r4[t_end] = 0.0;
+                }
+                for(int64_t i=first; i<last; i++) {
+                    const double* xi = x + i * num_timesteps;
+                    const double* yi = y + i * num_timesteps;
+                    const double* zi = z + i * num_timesteps;
+                    const double x0 = xi[t_start];
+                    const double y0 = yi[t_start];
+                    const double z0 = zi[t_start];
+                    #pragma omp simd
+                    for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                        const double dx = xi[t_end] - x0;
+                        const double dy = yi[t_end] - y0;
+                        const double dz = zi[t_end] - z0;
+                        const double s = dx*dx + dy*dy + dz*dz;
+                        d2[t_end] = s;
+                        row_r2[t_end] += s;
+                        row_r4[t_end] += s*s;
+                    }
+                    if (num_bins == 0) continue;
+                    for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                        const int64_t bin = (int64_t) (sqrt(d2[t_end]) * inv_dr);
+                        if (bin < num_bins) local_hist[lags[t_end] * num_bins + bin] += 1.0;
+                    }
+                }
+                for(int64_t t_end=t_start+1; t_end<num_timesteps; t_end++) {
+                    local_r2[lags[t_end]] += row_r2[t_end];
+                    local_r4[lags[t_end]] += row_r4[t_end];
+                    local_counts[lags[t_end]] += last - first;
+                }
+            }
+        }
+
+        if (ok) {
+            merge_displacement_statistics(local_r2, local_r4, local_hist, local_counts, stats);
+        }
+        free(local_r2);
+        free(local_r4);
+        free(local_hist);
+        free(local_counts);
+        free(rows);
+        free(lags);
+    }
+    if (failed) {
+        fprintf(stderr, "Failed to allocate memory for the windows of a thread\n");
+        free_displacement_statistics(stats);
+        return -1;
+    }
+
+    normalise_displacement_statistics(stats);
+    return 0;
+}
+
+void free_displacement_statistics(DisplacementStatistics* stats) {
+    free(stats->msd);
+    free(stats->alpha2);
+    free(stats->van_hove);
+    free(stats->counts);
+    stats->msd = NULL;
+    stats->alpha2 = NULL;
+    stats->van_hove = NULL;
+    stats->counts = NULL;
+}
@@ -5,6 +5,90 @@
 
 // Function declarations
 
-double compute_MSD(double* coord1, double* coord2, int num_atoms);
+// Number of lags of the time-origin windows shared by the lag-resolved averages of this library
+// (MSD, displacement statistics, F_s): from 0 to the span of `timesteps` in units of deltaTimestep,
+// rounded up. Missing frames do not reduce it, a late first frame does
+int64_t count_msd_lags(const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep);
+
+// Lag of the window from `timestep_start` to `timestep_end`, an index below `count_msd_lags`
+// [Assumption] Timesteps are all multiples of deltaTimestep from the first one
+static inline int64_t msd_lag_index(const int64_t timestep_start, const int64_t timestep_end, const int64_t deltaTimestep) {
+    return (timestep_end - timestep_start) / deltaTimestep;
+}
+
+double compute_MSD(const double* coord1, const double* coord2, const int num_atoms);
 double* compute_time_averaged_msd(const double* coord, const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep);
+
+// Time-averaged MSD of many atoms at once, also averaged over the atoms.
+// `coordinates` holds num_timesteps frames of num_atoms x 3 values (frame-major, as in LAMMPSData);
+// `atom_slots` lists the num_selected atoms to average over (NULL for all of them).
+// Atoms and time origins are spread over OpenMP threads (num_threads <= 0 for the OpenMP default)
+double* compute_ensemble_time_averaged_msd(const double* coordinates, const int64_t num_atoms,
+                                           const int64_t* atom_slots, const int64_t num_selected,
+                                           const int64_t* timesteps, const int64_t num_timesteps,
+                                           const int64_t deltaTimestep, const int num_threads);
+
+// Same as `compute_ensemble_time_averaged_msd` for atom-major series (the x, y, z arrays of a
+// LAMMPS_ATOM_MAJOR_SOA transpose): atom i at frame t is at x[i*num_timesteps + t]. The inner loop
+// runs over the frames of one atom with unit stride
+double* compute_ensemble_time_averaged_msd_xyz(const double* x, const double* y, const double* z,
+                                               const int64_t num_atoms, const int64_t* atom_slots, const int64_t num_selected,
+                                               const int64_t* timesteps, const int64_t num_timesteps,
+                                               const int64_t deltaTimestep, const int num_threads);
+
+// Same output as `compute_time_averaged_msd` (which stays as the reference) in O(T log T):
+// the MSD of every lag is obtained from autocorrelations computed with FFTs.
+// Missing frames are allowed; timesteps must be distinct multiples of deltaTimestep from the first one
+double* compute_time_averaged_msd_fft(const double* coord, const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep);
+
+// Same as `compute_time_averaged_msd` for a trajectory stored as separate x, y, z series
+// (e.g. one atom of a LAMMPS_ATOM_MAJOR_SOA transpose): the inner loop runs with unit stride
+double* compute_time_averaged_msd_xyz(const double* x, const double* y, const double* z,
+                                      const int64_t* timesteps, const int64_t num_timesteps, const int64_t deltaTimestep);
+
+/**
+ * @struct DisplacementStatistics
+ * @brief Per-lag statistics of the single-particle displacements, averaged over atoms and time origins
+ * @param num_lags Number of lags (same windows as `compute_time_averaged_msd`, lag 0 left at zero)
+ * @param num_bins Number of bins of the van Hove function between 0 and r_max
+ * @param msd <|dr|^2> at each lag
+ * @param alpha2 Non-Gaussian parameter 3<|dr|^4> / (5<|dr|^2>^2) - 1 at each lag
+ * @param van_hove Self part of the van Hove function G_s(r, lag) at van_hove[lag*num_bins + bin],
+ *        normalised so that the integral of 4 pi r^2 G_s over all r is 1
+ * @param counts Number of displacements behind each lag
+ */
+typedef struct DisplacementStatistics {
+    int64_t num_lags;
+    int64_t num_bins;
+    double r_max;
+    double* msd;
+    double* alpha2;
+    double* van_hove;
+    int64_t* counts;
+} DisplacementStatistics;
+
+// Accumulate, from a single evaluation of the displacements between two frames of num_atoms x 3
+// coordinates, the sum of |dr|^2, the sum of |dr|^4 and the histogram of |dr| (bins of width
+// 1/inv_dr, `histogram` may be NULL). The moments are vectorised over the atoms
+void accumulate_displacements(const double* coord1, const double* coord2, const int64_t num_atoms,
+                              const double inv_dr, const int64_t num_bins,
+                              double* r2_sum, double* r4_sum, double* histogram);
+
+// MSD, non-Gaussian parameter and self van Hove function of frame-major coordinates (as in LAMMPSData)
+// in one pass over the pairs of frames, time origins spread over OpenMP threads (num_threads <= 0
+// for the OpenMP default). Returns 0 on success, -1 on failure; free the result with `free_displacement_statistics`
+int compute_displacement_statistics(const double* coordinates, const int64_t num_atoms,
+                                    const int64_t* timesteps, const int64_t num_timesteps,
+                                    const int64_t deltaTimestep, const double r_max, const int64_t num_bins,
+                                    const int num_threads, DisplacementStatistics* stats);
+
+// Same as `compute_displacement_statistics` for atom-major series (the x, y, z arrays of a
+// LAMMPS_ATOM_MAJOR_SOA transpose): atom i at frame t is at x[i*num_timesteps + t]
+int compute_displacement_statistics_xyz(const double* x, const double* y, const double* z, const int64_t num_atoms,
+                                        const int64_t* timesteps, const int64_t num_timesteps,
+                                        const int64_t deltaTimestep, const double r_max, const int64_t num_bins,
+                                        const int num_threads, DisplacementStatistics* stats);
+
+// Free the arrays of a DisplacementStatistics (does NOT free the struct itself)
+void free_displacement_statistics(DisplacementStatistics* stats);
 #endif  // MSD_HI
@@ -0,0 +1,126 @@
+// multitau.c
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multitau.h"
+
+int init_multitau_msd(MultiTauMSD* mt, const int64_t num_atoms, const int64_t num_levels, const int64_t p, const int64_t m) {
+    memset(mt, 0, sizeof(MultiTauMSD));
+    if (num_atoms <= 0 || num_levels <= 0 || m < 2 || p < m || p % m != 0) {
+        fprintf(stderr, "Error: Invalid multiple-tau correlator (%ld atoms, %ld levels, p=%ld, m=%ld).\n",
+                num_atoms, num_levels, p, m);
+        return -1;
+    }
+    mt->num_atoms = num_atoms;
+    mt->num_levels = num_levels;
+    mt->p = p;
+    mt->m = m;
+
+    const size_t frame_len = 3 * (size_t) num_atoms;
+    mt->levels = calloc(num_levels, sizeof(CircularBuffer));
+    mt->accumulators = calloc(num_levels * frame_len, sizeof(double));
+    mt->accumulated = calloc(num_levels, sizeof(int64_t));
+    mt->msd_sum = calloc(num_levels * p, sizeof(double));
+    mt->msd_count = calloc(num_levels * p, sizeof(int64_t));
+    int failed = !mt->levels || !mt->accumulators || !mt->accumulated || !mt->msd_sum || !mt->msd_count;
+    for (int64_t l = 0; !failed && l < num_levels; l++) {
+        // One ring of doubles per level: p consecutive frames of 3N values
+        initCircularBuffer(&mt->levels[l], p * frame_len);
+        failed = !mt->levels[l].data;
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Memory allocation failed for a multiple-tau correlator of %ld atoms.\n", num_atoms);
+        free_multitau_msd(mt);
+        return -1;
+    }
+    return 0;
+}
+
+void free_multitau_msd(MultiTauMSD* mt) {
+    if (mt->levels) {
+        for (int64_t l = 0; l < mt->num_levels; l++) {
+            freeCircularBuffer(&mt->levels[l]);
+            mt->levels[l].data = NULL;
+        }
+    }
+    free(mt->levels);
+    free(mt->accumulators);
+    free(mt->accumulated);
+    free(mt->msd_sum);
+    free(mt->msd_count);
+    mt->levels = NULL;
+    mt->accumulators = NULL;
+    mt->accumulated = NULL;
+    mt->msd_sum = NULL;
+    mt->msd_count = NULL;
+}
+
+// Push an entry into `level`, correlate it with the entries already there, then pass it on to the
+// accumulator of the next level
+static void push_level(MultiTauMSD* mt, const int64_t level, const double* entry) {
+    const int64_t N = mt->num_atoms;
+    const size_t frame_len = 3 * (size_t) N;
+    CircularBuffer* cb = &mt->levels[level];
+
+    for (size_t k = 0; k < frame_len; k++) {
+        CIRCULARBUFFER_PUSH(cb, entry[k]);
+    }
+    const int64_t num_entries = (int64_t) (cb->i / frame_len);
+    const int64_t stored = (int64_t) (cb->count / frame_len);
+    const double* newest = cb->data + ((num_entries - 1) % mt->p) * frame_len;
+
+    // Lags below p/m are already resolved by the level below
+    const int64_t j_min = level == 0 ? 1 : mt->p / mt->m;
+    for (int64_t j = j_min; j < stored; j++) {
+        const double* older = cb->data + ((num_entries - 1 - j) % mt->p) * frame_len;
+        double msd = 0.;
+        #pragma omp simd reduction(+:msd)
+        for (size_t k = 0; k < frame_len; k++) {
+            const double d = newest[k] - older[k];
+            msd += d * d;
+        }
+        mt->msd_sum[level * mt->p + j] += msd / (double) N;
+        mt->msd_count[level * mt->p + j]++;
+    }
+
+    if (level + 1 == mt->num_levels) {
+        return;
+    }
+    double* acc = mt->accumulators + level * frame_len;
+    for (size_t k = 0; k < frame_len; k++) {
+        acc[k] += newest[k];
+    }
+    if (++mt->accumulated[level] == mt->m) {
+        const double inv_m = 1. / (double) mt->m;
+        for (size_t k = 0; k < frame_len; k++) {
+            acc[k] *= inv_m;
+        }
+        push_level(mt, level + 1, acc);
+        memset(acc, 0, frame_len * sizeof(double));
+        mt->accumulated[level] = 0;
+    }
+}
+
+void push_multitau_msd(MultiTauMSD* mt, const double* frame) {
+    push_level(mt, 0, frame);
+    mt->num_frames++;
+}
+
+int64_t get_multitau_msd(const MultiTauMSD* mt, int64_t* lags, double* msd) {
+    int64_t n = 0;
+    int64_t block = 1;
+    for (int64_t l = 0; l < mt->num_levels; l++) {
+        const int64_t j_min = l == 0 ? 1 : mt->p / mt->m;
+        for (int64_t j = j_min; j < mt->p; j++) {
+            const int64_t count = mt->msd_count[l * mt->p + j];
+            if (count == 0) continue;
+            lags[n] = j * block;
+            msd[n] = mt->msd_sum[l * mt->p + j] / (double) count;
+            n++;
+        }
+        block *= mt->m;
+    }
+    return n;
+}
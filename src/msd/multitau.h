@@ -0,0 +1,70 @@
+// multitau.h
+// On-the-fly multiple-tau correlator for the MSD of a set of atoms.
+//
+#pragma once
+
+#include <stdint.h>
+
+#include "CircularBuffer.h"
+
+/**
+ * @struct MultiTauMSD
+ * @brief Streaming MSD over logarithmically spaced lags (multiple-tau correlator)
+ *
+ * Level 0 keeps the last `p` frames; level l keeps the last `p` averages of `m^l` consecutive
+ * frames, built by averaging `m` entries of level l-1. Every new entry of level l is correlated
+ * with the entries already in that level, which gives lags j*m^l for j < p. Lags already covered
+ * by the level below are skipped, so the reported lags are
+ * 1, ..., p-1, (p/m)*m, ..., (p-1)*m, (p/m)*m^2, ... (in frames).
+ * Memory is O(num_atoms * num_levels * p) and each frame costs O(num_atoms * p * m / (m-1)) amortised.
+ * @remark At levels l >= 1 the positions are block averages, the usual multiple-tau approximation:
+ *         it is exact for lags much longer than the block (m^l frames)
+ * @param num_atoms Number of atoms in each frame
+ * @param num_levels Number of levels of the cascade
+ * @param p Entries kept per level
+ * @param m Block averaging factor between levels (must divide p)
+ * @param num_frames Number of frames pushed so far
+ * @param levels Ring of the last p entries of each level, p x num_atoms x 3 doubles
+ * @param accumulators Sum of the entries of each level waiting to be averaged into the next one
+ * @param accumulated Number of entries in each accumulator
+ * @param msd_sum Sum of the MSD at lag j of level l, in msd_sum[l*p + j]
+ * @param msd_count Number of terms in msd_sum
+ */
+typedef struct MultiTauMSD {
+    int64_t num_atoms;
+    int64_t num_levels;
+    int64_t p;
+    int64_t m;
+    int64_t num_frames;
+    CircularBuffer* levels;
+    double* accumulators;
+    int64_t* accumulated;
+    double* msd_sum;
+    int64_t* msd_count;
+} MultiTauMSD;
+
+/**
+ * @brief Allocate a correlator for `num_atoms` atoms
+ * @return 0 on success, -1 on failure
+ */
+int init_multitau_msd(MultiTauMSD* mt, const int64_t num_atoms, const int64_t num_levels, const int64_t p, const int64_t m);
+
+/**
+ * @brief Free the memory of the correlator
+ * @warning does NOT free the struct itself
+ */
+void free_multitau_msd(MultiTauMSD* mt);
+
+/**
+ * @brief Add the next frame (num_atoms x 3 coordinates, unwrapped) to the correlator.
+ * Frames must be equally spaced in time.
+ */
+void push_multitau_msd(MultiTauMSD* mt, const double* frame);
+
+/**
+ * @brief MSD (averaged over atoms and time origins) at every lag that has at least one sample
+ * @param lags Lags in frames, at least num_levels*p entries
+ * @param msd MSD at each lag, at least num_levels*p entries
+ * @return Number of lags written, in increasing order
+ */
+int64_t get_multitau_msd(const MultiTauMSD* mt, int64_t* lags, double* msd);